@@ -0,0 +1,275 @@
+#include "BundleWriter.hpp"
+
+static const char *list_filename = "bundle.lst";
+static const char *commit_filename = "bundle.cmt";
+
+BundleWriter::BundleWriter(MqttNetStorage *storage) : storage(storage), writer(storage) {
+  _expected_md5[0] = 0;
+}
+
+void BundleWriter::onEntry(entry_handler_t handler) {
+  entry_handler = handler;
+}
+
+void BundleWriter::stagingName(char *name, unsigned int index) {
+  snprintf(name, 16, "bundle.%u", index);
+}
+
+void BundleWriter::Abort() {
+  writer.Abort();
+  if (list_handle >= 0) {
+    storage->close(list_handle);
+    list_handle = -1;
+  }
+  discard(list_filename);
+  _size = 0;
+  _position = 0;
+  staged = 0;
+  header_len = 0;
+  name_len = 0;
+  remaining = 0;
+  in_entry = false;
+  skipping = false;
+  active = false;
+}
+
+// completes a commit interrupted by a reset or a failed rename, or drops a
+// bundle that was never verified
+bool BundleWriter::Recover() {
+  if (storage->exists(commit_filename)) {
+    Serial.println("BundleWriter: completing interrupted commit");
+    if (install()) {
+      return true;
+    }
+    // second attempt for these entries, give up on them
+    discard(commit_filename);
+    error = "install failed";
+    return false;
+  }
+  if (storage->exists(list_filename)) {
+    discard(list_filename);
+  }
+  return false;
+}
+
+bool BundleWriter::Begin(const char *md5, size_t size) {
+  Recover();
+  Abort();
+  list_handle = storage->open(list_filename, "w");
+  if (list_handle < 0) {
+    return fail("open failed");
+  }
+  strncpy(_expected_md5, md5, sizeof(_expected_md5));
+  _expected_md5[sizeof(_expected_md5) - 1] = 0;
+  _size = size;
+  _md5.begin();
+  error = "";
+  active = true;
+  return true;
+}
+
+// data may end anywhere within a header or an entry
+bool BundleWriter::Add(uint8_t *data, unsigned int len) {
+  if (!active) {
+    return false;
+  }
+  if (_position + len > _size) {
+    return fail("bundle too long");
+  }
+  _md5.add(data, len);
+  _position += len;
+  while (len > 0) {
+    if (!in_entry) {
+      uint8_t c = *data++;
+      len--;
+      header[header_len++] = c;
+      if (name_len == 0) {
+        if (c == 0) {
+          if (header_len == 1) {
+            return fail("bad entry header");
+          }
+          name_len = header_len - 1;
+        } else if (header_len >= MQTTNET_FILENAME_MAX) {
+          return fail("name too long");
+        }
+      } else if (header_len == name_len + 21 && !startEntry()) {
+        return false;
+      }
+    } else {
+      size_t n = len < remaining ? len : remaining;
+      if (!skipping && n > 0 && !writer.Add(data, n)) {
+        return fail("add failed");
+      }
+      data += n;
+      len -= n;
+      remaining -= n;
+      if (remaining == 0 && !finishEntry()) {
+        return false;
+      }
+    }
+  }
+  return true;
+}
+
+bool BundleWriter::startEntry() {
+  const char *name = (const char *)header;
+  const uint8_t *p = header + name_len + 1;
+  size_t size = ((size_t)p[0] << 24) | ((size_t)p[1] << 16) | ((size_t)p[2] << 8) | p[3];
+  char md5[33];
+  for (int i = 0; i < 16; i++) {
+    snprintf(md5 + 2 * i, 3, "%02x", p[4 + i]);
+  }
+  if (strncmp(name, "bundle.", 7) == 0) {
+    return fail("invalid name");
+  }
+  if (!writer.Begin(name, md5, size)) {
+    return fail("begin failed");
+  }
+  in_entry = true;
+  remaining = size;
+  skipping = writer.UpToDate();
+  if (!skipping && !writer.Open()) {
+    return fail("open failed");
+  }
+  return remaining > 0 || finishEntry();
+}
+
+bool BundleWriter::finishEntry() {
+  const char *name = (const char *)header;
+  if (skipping) {
+    writer.Abort();
+    if (entry_handler) {
+      entry_handler(name, "unchanged");
+    }
+  } else {
+    char staging[16];
+    stagingName(staging, staged);
+    if (!writer.Stage(staging)) {
+      if (entry_handler) {
+        entry_handler(name, "error: md5 mismatch");
+      }
+      return fail("entry md5 mismatch");
+    }
+    if (storage->write(list_handle, header, name_len) != name_len ||
+        storage->write(list_handle, (const uint8_t *)"\n", 1) != 1) {
+      storage->remove(staging);
+      return fail("list write failed");
+    }
+    staged++;
+    if (entry_handler) {
+      entry_handler(name, "staged");
+    }
+  }
+  header_len = 0;
+  name_len = 0;
+  in_entry = false;
+  skipping = false;
+  return true;
+}
+
+// checks the MD5 of the whole bundle and moves all staged entries into place
+bool BundleWriter::Commit() {
+  if (!active) {
+    return false;
+  }
+  if (in_entry || header_len > 0 || _position != _size) {
+    return fail("truncated bundle");
+  }
+  _md5.calculate();
+  if (strcmp(_md5.toString().c_str(), _expected_md5) != 0) {
+    return fail("bundle md5 mismatch");
+  }
+  storage->close(list_handle);
+  list_handle = -1;
+  if (!storage->rename(list_filename, commit_filename)) {
+    return fail("commit failed");
+  }
+  if (!install()) {
+    return fail("install failed");
+  }
+  Abort();
+  return true;
+}
+
+// moves the staged entries listed in bundle.cmt into place; if one cannot
+// be moved, it stays staged and bundle.cmt is kept for Recover()
+bool BundleWriter::install() {
+  bool installed = true;
+  forEachListed(commit_filename, [this, &installed](unsigned int index, const char *name) {
+    char staging[16];
+    stagingName(staging, index);
+    if (!storage->exists(staging)) {
+      return;
+    }
+    if (writer.Replace(staging, name)) {
+      if (entry_handler) {
+        entry_handler(name, "committed");
+      }
+    } else {
+      Serial.print("BundleWriter: rename failed: ");
+      Serial.println(name);
+      if (entry_handler) {
+        entry_handler(name, "error: rename failed");
+      }
+      installed = false;
+    }
+  });
+  if (installed) {
+    storage->remove(commit_filename);
+  }
+  return installed;
+}
+
+void BundleWriter::discard(const char *list) {
+  forEachListed(list, [this](unsigned int index, const char *name) {
+    (void)name;
+    char staging[16];
+    stagingName(staging, index);
+    storage->remove(staging);
+  });
+  storage->remove(list);
+}
+
+void BundleWriter::forEachListed(const char *list, std::function<void(unsigned int index, const char *name)> fn) {
+  int handle = storage->open(list, "r");
+  if (handle < 0) {
+    return;
+  }
+  char name[MQTTNET_FILENAME_MAX];
+  size_t len = 0;
+  unsigned int index = 0;
+  uint8_t buf[64];
+  size_t n;
+  while ((n = storage->read(handle, buf, sizeof(buf))) > 0) {
+    for (size_t i = 0; i < n; i++) {
+      if (buf[i] == '\n') {
+        name[len] = 0;
+        fn(index++, name);
+        len = 0;
+      } else if (len < sizeof(name) - 1) {
+        name[len++] = buf[i];
+      }
+    }
+  }
+  storage->close(handle);
+}
+
+bool BundleWriter::fail(const char *reason) {
+  Serial.print("BundleWriter: ");
+  Serial.println(reason);
+  Abort();
+  error = reason;
+  return false;
+}
+
+bool BundleWriter::Running() {
+  return active;
+}
+
+int BundleWriter::GetPosition() {
+  return _position;
+}
+
+const char *BundleWriter::GetError() {
+  return error;
+}
@@ -0,0 +1,61 @@
+#ifndef BUNDLEWRITER_HPP
+#define BUNDLEWRITER_HPP
+
+#include "FileWriter.hpp"
+
+// Unpacks a bundle of files streamed as one sync. Every entry is a header
+//
+//   name, 0, size (4 bytes, big endian), md5 (16 bytes)
+//
+// followed by size bytes of data. Entries are written through FileWriter
+// and staged as bundle.<n> while the names are listed in bundle.lst;
+// entries whose file is already up to date are skipped. Once the MD5 of
+// the whole bundle matches, the list is renamed to bundle.cmt and the
+// staged files are moved into place. A commit interrupted by a reset, or
+// with entries that could not be moved, is completed by Recover(); entries
+// that fail there again are dropped.
+class BundleWriter {
+ public:
+  typedef std::function<void(const char *name, const char *state)> entry_handler_t;
+
+ private:
+  static const size_t header_max = MQTTNET_FILENAME_MAX + 20;
+  MqttNetStorage *storage;
+  FileWriter writer;
+  entry_handler_t entry_handler;
+  MD5Builder _md5;
+  char _expected_md5[33];
+  size_t _size = 0;
+  size_t _position = 0;
+  int list_handle = -1;
+  unsigned int staged = 0;
+  uint8_t header[header_max];
+  size_t header_len = 0;
+  size_t name_len = 0;
+  size_t remaining = 0;
+  bool in_entry = false;
+  bool skipping = false;
+  bool active = false;
+  const char *error = "";
+  bool fail(const char *reason);
+  bool startEntry();
+  bool finishEntry();
+  void forEachListed(const char *list, std::function<void(unsigned int index, const char *name)> fn);
+  bool install();
+  void discard(const char *list);
+  static void stagingName(char *name, unsigned int index);
+
+ public:
+  BundleWriter(MqttNetStorage *storage);
+  void onEntry(entry_handler_t handler);
+  bool Begin(const char *md5, size_t size);
+  bool Add(uint8_t *data, unsigned int len);
+  bool Commit();
+  void Abort();
+  bool Recover();
+  bool Running();
+  int GetPosition();
+  const char *GetError();
+};
+
+#endif
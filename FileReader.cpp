@@ -0,0 +1,78 @@
+#include "FileReader.hpp"
+
+FileReader::FileReader(MqttNetStorage *storage) : storage(storage) {
+}
+
+void FileReader::Abort() {
+  if (file_handle >= 0) {
+    storage->close(file_handle);
+    file_handle = -1;
+  }
+  _size = 0;
+  _position = 0;
+}
+
+// opens filename and skips to offset, hashing the skipped part
+bool FileReader::Begin(const char *filename, size_t offset) {
+  Abort();
+  file_handle = storage->open(filename, "r");
+  if (file_handle < 0) {
+    Serial.println("FileReader: begin(): file not found");
+    return false;
+  }
+  _size = storage->size(file_handle);
+  if (offset > _size) {
+    Serial.println("FileReader: begin(): offset beyond end of file");
+    Abort();
+    return false;
+  }
+  _md5.begin();
+  uint8_t buf[256];
+  while (_position < offset) {
+    size_t len = offset - _position < sizeof(buf) ? offset - _position : sizeof(buf);
+    if (storage->read(file_handle, buf, len) != len) {
+      Serial.println("FileReader: begin(): read failed");
+      Abort();
+      return false;
+    }
+    _md5.add(buf, len);
+    _position += len;
+  }
+  return true;
+}
+
+// reads up to len bytes, returns 0 at the end of the file or on errors
+size_t FileReader::Read(uint8_t *data, size_t len) {
+  if (file_handle < 0) {
+    return 0;
+  }
+  if (len > _size - _position) {
+    len = _size - _position;
+  }
+  size_t n = storage->read(file_handle, data, len);
+  _md5.add(data, n);
+  _position += n;
+  return n;
+}
+
+// MD5 of the whole file, once Done()
+String FileReader::GetMD5() {
+  _md5.calculate();
+  return _md5.toString();
+}
+
+bool FileReader::Running() {
+  return file_handle >= 0;
+}
+
+bool FileReader::Done() {
+  return file_handle >= 0 && _position >= _size;
+}
+
+size_t FileReader::GetPosition() {
+  return _position;
+}
+
+size_t FileReader::GetSize() {
+  return _size;
+}
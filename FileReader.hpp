@@ -0,0 +1,29 @@
+#ifndef FILEREADER_HPP
+#define FILEREADER_HPP
+
+#include "MqttNetPlatform.hpp"
+
+// Streams a file from storage in caller sized chunks, the counterpart of
+// FileWriter for net/fetch/*. The MD5 covers the whole file, also when
+// reading starts at an offset.
+class FileReader {
+ private:
+  MqttNetStorage *storage;
+  int file_handle = -1;
+  size_t _size = 0;
+  size_t _position = 0;
+  MD5Builder _md5;
+
+ public:
+  FileReader(MqttNetStorage *storage);
+  bool Begin(const char *filename, size_t offset);
+  size_t Read(uint8_t *data, size_t len);
+  String GetMD5();
+  void Abort();
+  bool Running();
+  bool Done();
+  size_t GetPosition();
+  size_t GetSize();
+};
+
+#endif
@@ -6,7 +6,7 @@
 
 // FileWriter is a class which is define in FileWriter.hpp header file
 // FileWriter() is a member function of class FileWriter , which is define outside the class 
-FileWriter::FileWriter() {
+FileWriter::FileWriter(MqttNetStorage *storage) : storage(storage) {
   strncpy(_filename, "", sizeof(_filename));
   strncpy(_md5, "", sizeof(_md5));
   _size = 0;
@@ -14,10 +14,11 @@ FileWriter::FileWriter() {
 
 // again defining a member function called Abort() of class FileWriter
 void FileWriter::Abort() {
-  if (file_handle) {
-    file_handle.close();
+  if (file_handle >= 0) {
+    storage->close(file_handle);
+    file_handle = -1;
   }
-  SPIFFS.remove(tmp_filename);
+  storage->remove(tmp_filename);
   strncpy(_filename, "", sizeof(_filename));
   strncpy(_md5, "", sizeof(_md5));
   _size = 0;
@@ -27,9 +28,13 @@ void FileWriter::Abort() {
 
 // defining a member function Begin() of class FileWriter, which is returning boolean value
 bool FileWriter::Begin(const char *filename, const char *md5, size_t size) {
+  if (strlen(filename) >= sizeof(_filename)) {
+    Serial.println("FileWriter: begin(): file name too long");
+    return false;
+  }
   if (active) {
     Serial.println("FileWriter: begin(): aborting existing task first");
-    abort();
+    Abort();
   }
   active = true;
   strncpy(_filename, filename, sizeof(_filename));
@@ -40,9 +45,9 @@ bool FileWriter::Begin(const char *filename, const char *md5, size_t size) {
 
 //defining a member function Add() of class FileWriter
 bool FileWriter::Add(uint8_t *data, unsigned int len) {
-  if (file_open) {
+  if (file_open && storage->write(file_handle, data, len) == len) {
     received_size += len;
-    return file_handle.write(data, len);
+    return true;
   } else {
     return false;
   }
@@ -51,9 +56,12 @@ bool FileWriter::Add(uint8_t *data, unsigned int len) {
 //defining a member function Add() of class FileWriter
 bool FileWriter::Add(uint8_t *data, unsigned int len, unsigned int pos) {
   if (file_open) {
-    if (file_handle.seek(pos, SeekSet)) {
+    if (!fill_to(pos)) {
+      return false;
+    }
+    if (storage->seek(file_handle, pos) && storage->write(file_handle, data, len) == len) {
       received_size += len;
-      return file_handle.write(data, len);
+      return true;
     } else {
       return false;
     }
@@ -64,22 +72,65 @@ bool FileWriter::Add(uint8_t *data, unsigned int len, unsigned int pos) {
 
 //defining a member function Commit() of class FileWriter   
 bool FileWriter::Commit() {
-  if (file_handle) {
-    file_handle.close();
+  if (!verify()) {
+    return false;
+  }
+  if (!Replace(tmp_filename, _filename)) {
+    Serial.println("FileWriter: commit: rename failed");
+    Abort();
+    return false;
+  }
+  active = false;
+  return true;
+}
+
+//defining a member function Stage() of class FileWriter, which keeps the
+//verified file under the name staging until Replace() moves it
+bool FileWriter::Stage(const char *staging) {
+  if (!verify()) {
+    return false;
+  }
+  storage->remove(staging);
+  if (!storage->rename(tmp_filename, staging)) {
+    Serial.println("FileWriter: stage: rename failed");
+    Abort();
+    return false;
+  }
+  strncpy(_filename, "", sizeof(_filename));
+  strncpy(_md5, "", sizeof(_md5));
+  _size = 0;
+  active = false;
+  return true;
+}
+
+//defining a member function Replace() of class FileWriter, which moves the
+//file from onto the file to
+bool FileWriter::Replace(const char *from, const char *to) {
+  make_parent_dirs(to);
+  if (!storage->renameReplaces()) {
+    storage->remove(to);
+  }
+  return storage->rename(from, to);
+}
+
+//defining a member function verify() of class FileWriter, which closes the
+//temporary file and compares it with the advertised size and md5
+bool FileWriter::verify() {
+  if (file_handle >= 0) {
+    storage->close(file_handle);
+    file_handle = -1;
     file_open = false;
 
     MD5Builder tmp_md5;
-    File tmp_file = SPIFFS.open(tmp_filename, "r");
-    size_t tmp_file_size = tmp_file.size();
-    tmp_md5.begin();
-    while (tmp_file.available()) {
-      uint8_t buf[256];
-      size_t buflen;
-      buflen = tmp_file.readBytes((char *)buf, 256);
-      tmp_md5.add(buf, buflen);
+    size_t tmp_file_size = 0;
+    int tmp_file = storage->open(tmp_filename, "r");
+    if (tmp_file >= 0) {
+      tmp_file_size = storage->size(tmp_file);
+    }
+    parse_md5_file(&tmp_md5, tmp_file);
+    if (tmp_file >= 0) {
+      storage->close(tmp_file);
     }
-    tmp_md5.calculate();
-    tmp_file.close();
 
     Serial.print("FileWriter: advertised: md5=");
     Serial.print(_md5);
@@ -94,9 +145,6 @@ bool FileWriter::Commit() {
     if (_size == tmp_file_size &&
         strcmp(tmp_md5.toString().c_str(), _md5) == 0) {
       Serial.println(" match");
-      SPIFFS.remove(_filename);
-      SPIFFS.rename(tmp_filename, _filename);
-      active = false;
       return true;
     } else {
       Serial.println(" mismatch!");
@@ -110,8 +158,8 @@ bool FileWriter::Commit() {
 
 //defining a member function Open() of class FileWriter    
 bool FileWriter::Open() {
-  file_handle = SPIFFS.open(tmp_filename, "w");
-  if (file_handle) {
+  file_handle = storage->open(tmp_filename, "w");
+  if (file_handle >= 0) {
     received_size = 0;
     file_open = true;
     active = true;
@@ -137,10 +185,15 @@ bool FileWriter::Running() {
 //defining a member function UpToDate() of class FileWriter
 bool FileWriter::UpToDate() {
   MD5Builder md5;
-  File f = SPIFFS.open(_filename, "r");
-  size_t size = f.size();
-  parse_md5_stream(&md5, &f);
-  f.close();
+  size_t size = 0;
+  int f = storage->open(_filename, "r");
+  if (f >= 0) {
+    size = storage->size(f);
+  }
+  parse_md5_file(&md5, f);
+  if (f >= 0) {
+    storage->close(f);
+  }
 
   Serial.print("FileWriter: file offered local=");
   Serial.print(size, DEC);
@@ -151,7 +204,8 @@ bool FileWriter::UpToDate() {
   Serial.print("/");
   Serial.print(_md5);
 
-  if (size == _size && strcmp(md5.toString().c_str(), _md5) == 0) {
+  // a missing file is never up to date, not even for an empty one
+  if (f >= 0 && size == _size && strcmp(md5.toString().c_str(), _md5) == 0) {
     Serial.println(" [ok]");
     return true;
   } else {
@@ -160,14 +214,48 @@ bool FileWriter::UpToDate() {
   }
 }
 
-//defining a member function parse_md5_stream() of class FileWriter
-void FileWriter::parse_md5_stream(MD5Builder *md5, Stream *stream) {
+//defining a member function fill_to() of class FileWriter, which pads the
+//file with zeros up to pos, as not every storage can seek beyond its end
+bool FileWriter::fill_to(unsigned int pos) {
+  size_t size = storage->size(file_handle);
+  if (pos <= size) {
+    return true;
+  }
+  if (!storage->seek(file_handle, size)) {
+    return false;
+  }
+  uint8_t zeros[64] = {};
+  while (size < pos) {
+    size_t len = pos - size < sizeof(zeros) ? pos - size : sizeof(zeros);
+    if (storage->write(file_handle, zeros, len) != len) {
+      return false;
+    }
+    size += len;
+  }
+  return true;
+}
+
+//defining a member function make_parent_dirs() of class FileWriter, for
+//storages with directories
+void FileWriter::make_parent_dirs(const char *path) {
+  const char *slash = strrchr(path, '/');
+  if (slash && slash != path) {
+    char parent[MQTTNET_FILENAME_MAX];
+    memcpy(parent, path, slash - path);
+    parent[slash - path] = 0;
+    storage->mkdir(parent);
+  }
+}
+
+//defining a member function parse_md5_file() of class FileWriter
+void FileWriter::parse_md5_file(MD5Builder *md5, int handle) {
   md5->begin();
-  while (stream->available()) {
+  if (handle >= 0) {
     uint8_t buf[256];
     size_t buflen;
-    buflen = stream->readBytes((char *)buf, 256);
-    md5->add(buf, buflen);
+    while ((buflen = storage->read(handle, buf, sizeof(buf))) > 0) {
+      md5->add(buf, buflen);
+    }
   }
   md5->calculate();
 }
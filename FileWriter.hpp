@@ -4,32 +4,37 @@
 #define FILEWRITER_HPP
 
 //......................define  headers for using several function, which is included in these header files...............................
-#include <Arduino.h>
-#include <FS.h>
+#include "MqttNetPlatform.hpp"
 
 // defining a class called FileWriter
 class FileWriter {
  // using private keyword to define some members of class private, so that they doesnot access outside the class.
  private:
-  File file_handle;
-  char _filename[15];
+  MqttNetStorage *storage;
+  int file_handle = -1;
+  char _filename[MQTTNET_FILENAME_MAX];
   char _md5[33];
   size_t _size = 0;
   bool active = false;
   bool file_open = false;
   unsigned int received_size;
   const char *tmp_filename = "tmp";
-  void parse_md5_stream(MD5Builder *md5, Stream *stream);
+  void parse_md5_file(MD5Builder *md5, int handle);
+  void make_parent_dirs(const char *path);
+  bool verify();
+  bool fill_to(unsigned int pos);
  
  // deining some members of class public, so that they accessible outside the class using its OBJECTS
  public:
-  FileWriter();
+  FileWriter(MqttNetStorage *storage);
   bool Begin(const char *filename, const char *md5, size_t size);
   bool UpToDate();
   bool Open();
   bool Add(uint8_t *data, unsigned int len);
   bool Add(uint8_t *data, unsigned int len, unsigned int pos);
   bool Commit();
+  bool Stage(const char *staging);
+  bool Replace(const char *from, const char *to);
   void Abort();
   bool Running();
   int GetPosition();
@@ -1,5 +1,7 @@
 #include "FirmwareWriter.hpp"
 
+#if MQTTNET_FIRMWARE
+
 #include <Updater.h>
 
 FirmwareWriter::FirmwareWriter() {
@@ -151,3 +153,5 @@ bool FirmwareWriter::UpToDate() {
     return false;
   }
 }
+
+#endif
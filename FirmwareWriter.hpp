@@ -1,7 +1,7 @@
 #ifndef FIRMWAREWRITER_HPP
 #define FIRMWAREWRITER_HPP
 
-#include <Arduino.h>
+#include "MqttNetPlatform.hpp"
 
 class FirmwareWriter {
  private:
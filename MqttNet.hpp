@@ -1,97 +1,312 @@
 #ifndef MQTTNET_HPP
 #define MQTTNET_HPP
 
-#include <AsyncMqttClient.h>
-#include <ESP8266WiFi.h>
-#include <Ticker.h>
-#include <queue>
+#include <stdarg.h>
+#include <type_traits>
 
+#include "MqttNetPlatform.hpp"
+#include "MqttNetBatch.hpp"
+#include "MqttNetChunks.hpp"
+#include "MqttNetMetrics.hpp"
+#include "MqttNetQueue.hpp"
+#include "MqttNetSpscQueue.hpp"
+#include "MqttNetSubscriptions.hpp"
+#include "BundleWriter.hpp"
 #include "FirmwareWriter.hpp"
+#include "FileReader.hpp"
 #include "FileWriter.hpp"
 
 typedef void (*mqttnet_connect_callback_t)(bool sessionPresent);
-typedef void (*mqttnet_disconnect_callback_t)(AsyncMqttClientDisconnectReason reason);
-typedef void (*mqttnet_message_callback_t)(String topic, char* payload, AsyncMqttClientMessageProperties properties, size_t len, size_t index, size_t total);
+typedef void (*mqttnet_disconnect_callback_t)(MqttNetDisconnectReason reason);
+
+// The callbacks get plain C strings, which are only valid during the call.
+// Sketches written against the String signatures can define
+// MQTTNET_STRING_CALLBACKS 1, at the cost of an allocation per callback.
+#ifndef MQTTNET_STRING_CALLBACKS
+#define MQTTNET_STRING_CALLBACKS 0
+#endif
+
+#if MQTTNET_STRING_CALLBACKS
+typedef void (*mqttnet_message_callback_t)(String topic, char* payload, MqttNetMessageProperties properties, size_t len, size_t index, size_t total);
 typedef void (*mqttnet_string_callback_t)(String topic, String payload, bool retain);
 typedef void (*mqttnet_file_callback_t)(String filename);
+#else
+typedef void (*mqttnet_message_callback_t)(const char* topic, char* payload, MqttNetMessageProperties properties, size_t len, size_t index, size_t total);
+typedef void (*mqttnet_string_callback_t)(const char* topic, const char* payload, bool retain);
+typedef void (*mqttnet_file_callback_t)(const char* filename);
+#endif
 
-class MqttNetMessage {
+// Compile time configuration of MqttNetT. Derive from it and shadow the
+// members that should differ, e.g.
+//
+//   struct SmallConfig : MqttNetDefaultConfig {
+//     static const size_t publish_pool = 512;
+//     static const bool sync = false;
+//   };
+//   MqttNetT<SmallConfig> mqttNet;
+struct MqttNetDefaultConfig {
+  // publish queue: at most publish_queue messages in publish_pool bytes
+  static const size_t publish_queue = 32;
+  static const size_t publish_pool = 2048;
+  // subscription table: at most subscriptions topic filters in
+  // subscription_pool bytes, replayed after a reconnect without session
+  static const size_t subscriptions = 20;
+  static const size_t subscription_pool = 640;
+  // pending subscriptions are batched into SUBSCRIBE packets of up to
+  // this many payload bytes
+  static const size_t max_subscribe_packet = 512;
+  // topic filters the broker rejected are subscribed again after this many
+  // milliseconds
+  static const uint32_t subscribe_retry = 30000;
+  // subscribe to <prefix>/net/sync/+ instead of every net/sync/* topic and
+  // drop the messages MqttNet does not handle locally
+  static const bool collapse_internal = false;
+  // inbound queue: received messages are copied into inbound_pool bytes and
+  // handled from the main loop, in chunks of at most inbound_chunk bytes
+  static const size_t inbound_pool = 2048;
+  static const size_t inbound_chunk = 512;
+  // longest full topic (including prefix and terminator) and payload
+  static const size_t max_topic = 64;
+  static const size_t max_payload = 512;
+  static const uint32_t dequeue_interval = 125;
+  // work done per dequeue run before yielding to loop(), at least one
+  // message is sent per run
+  static const uint32_t dequeue_budget_us = 2000;
+  static const size_t dequeue_budget_bytes = 2048;
+  static const uint32_t stats_interval = 60000;
+  // readings passed to add() are published as one CBOR map of up to
+  // batch_size bytes, when it is full, holds batch_count readings or
+  // batch_interval ms after its first reading
+  static const size_t batch_size = 256;
+  static const size_t batch_count = 32;
+  static const uint32_t batch_interval = 10000;
+  // subsystems, disabled ones are not compiled in
+  static const bool sync = true;
+  // net/sync/chunk messages carry up to sync_chunk bytes with an offset and
+  // a CRC32, and are buffered until the CRC is verified
+  static const size_t sync_chunk = 512;
+  // net/fetch/* sends files in chunks of fetch_chunk bytes (less if
+  // max_payload is smaller), with at most fetch_window chunks of credit
+  // outstanding
+  static const bool fetch = true;
+  static const size_t fetch_chunk = 256;
+  static const uint32_t fetch_window = 64;
+  static const bool batch = true;
+  static const bool firmware = MQTTNET_FIRMWARE;
+  static const bool stats = true;
+  static const bool metadata = true;
+  // fail the build if sizeof(MqttNetT<Config>) exceeds this, 0 to disable
+  static const size_t ram_budget = 0;
+};
+
+// lets a disabled MqttNetOptional take no space; compilers without the
+// attribute keep one byte per member
+#if defined(__has_cpp_attribute)
+#if __has_cpp_attribute(no_unique_address)
+#define MQTTNET_NO_UNIQUE_ADDRESS [[no_unique_address]]
+#endif
+#endif
+#ifndef MQTTNET_NO_UNIQUE_ADDRESS
+#define MQTTNET_NO_UNIQUE_ADDRESS
+#endif
+
+template <bool Enabled, typename T>
+class MqttNetOptional {
  public:
-  String topic;
-  String payload;
-  uint8_t qos = 0;
-  bool retain = false;
+  T value;
+  template <typename... Args>
+  MqttNetOptional(Args... args) : value(args...) {}
 };
 
-class MqttNetSubscribe {
+template <typename T>
+class MqttNetOptional<false, T> {
  public:
-  String topic;
-  uint8_t qos = 0;
+  template <typename... Args>
+  MqttNetOptional(Args...) {}
 };
 
-class MqttNet {
+template <typename Config>
+class MqttNetT {
  private:
-  AsyncMqttClient *mqttClient;
-  Ticker mqttReconnectTimer;
-  Ticker dequeueTicker;
-  Ticker statsTicker;
-  Ticker watchdogTicker;
-  WiFiEventHandler wifiConnectHandler;
-  WiFiEventHandler wifiDisconnectHandler;
-  FirmwareWriter firmwareWriter;
-  FileWriter fileWriter;
-  String newFileName;
-  String newFileMD5;
-  int newFileSize;
-  const char *clientid;
+  typedef std::integral_constant<bool, Config::sync> sync_enabled;
+  typedef std::integral_constant<bool, Config::firmware> firmware_enabled;
+  typedef std::integral_constant<bool, Config::batch> batch_enabled;
+  typedef std::integral_constant<bool, Config::fetch> fetch_enabled;
+  typedef std::integral_constant<bool, Config::stats> stats_enabled;
+  typedef MqttNetSubscriptionTable<Config::subscription_pool, Config::subscriptions> subscription_table_t;
+
+  struct InboundHeader {
+    uint32_t index;
+    uint32_t total;
+    uint16_t length;
+    MqttNetMessageProperties properties;
+  };
+  // largest inbound record; as a record needs contiguous space, receiving
+  // is paused while less than two of them fit and resumed with a quarter of
+  // the pool to spare
+  static const size_t inbound_record = sizeof(InboundHeader) + Config::max_topic + Config::inbound_chunk + 2;
+  static const size_t inbound_pause = 2 * inbound_record;
+  static const size_t inbound_resume = inbound_pause + Config::inbound_pool / 4;
+  // data bytes per net/fetch/data message: fetch_chunk, cut down to what
+  // fits into max_payload next to the 4 byte offset
+  static const size_t fetch_chunk = Config::fetch_chunk + 4 <= Config::max_payload ? Config::fetch_chunk : Config::max_payload - 4;
+
+  MqttNetPlatform &platform;
+  MqttNetClient *mqttClient;
+  MqttNetTimer &mqttReconnectTimer;
+  MqttNetTimer &dequeueTicker;
+  MqttNetTimer &dequeueResumeTimer;
+  MqttNetTimer &inboundTimer;
+  MqttNetTimer &batchTimer;
+  MqttNetTimer &statsTicker;
+  MqttNetTimer &watchdogTicker;
+  MqttNetNetwork &network;
+  MQTTNET_NO_UNIQUE_ADDRESS MqttNetOptional<Config::firmware, FirmwareWriter> firmwareWriter;
+  MQTTNET_NO_UNIQUE_ADDRESS MqttNetOptional<Config::sync, FileWriter> fileWriter;
+  MQTTNET_NO_UNIQUE_ADDRESS MqttNetOptional<Config::sync, BundleWriter> bundleWriter;
+  MQTTNET_NO_UNIQUE_ADDRESS MqttNetOptional<Config::sync, MqttNetChunkReceiver<Config::sync_chunk> > syncChunks;
+  MQTTNET_NO_UNIQUE_ADDRESS MqttNetOptional<Config::fetch, FileReader> fileReader;
+  uint32_t fetchCredit = 0;
+  MQTTNET_NO_UNIQUE_ADDRESS MqttNetOptional<Config::batch, MqttNetBatch<Config::batch_size, Config::max_topic> > batch;
+  char newFileName[MQTTNET_FILENAME_MAX];
+  char newFileMD5[33];
+  int newFileSize = -1;
+  const char *clientid = nullptr;
   const char *mqtt_host;
   uint16_t mqtt_port;
   bool mqtt_tls;
   const char *mqtt_username;
   const char *mqtt_password;
   const char *mqtt_prefix = "test/123/";
-  char will_topic[64];
+  char will_topic[Config::max_topic];
   bool _restartRequiredForNetwork = false;
   bool _restartRequiredForFirmware = false;
   bool _restartRequiredForWatchdog = false;
-  int _maxSubscribeQueue = 20;
-  int _maxPublishQueue = 20;
-  int _statsInterval = 60000;
   time_t _watchdogLastOk = 0;
   long _watchdogRestartTimeout = 0;
-  int _metric_wifi_reconnections = -1;
-  int _metric_mqtt_reconnections = -1;
-  std::queue<MqttNetMessage> pubqueue;
-  std::queue<MqttNetSubscribe> subqueue;
+  MqttNetMessageQueue<Config::publish_pool, Config::publish_queue> pubqueue;
+  subscription_table_t subscriptions;
+  unsigned long _subscribeFailedAt = 0;
+  MqttNetSpscQueue<Config::inbound_pool> inqueue;
+  std::atomic<bool> _inbound_paused;
+  // set in the receive callback once a chunk did not fit, the rest of that
+  // message is dropped too; a lost sync message aborts the transfer after
+  // the records queued before it are handled
+  bool _inbound_dropping = false;
+  uint32_t _inbound_committed = 0;
+  uint32_t _inbound_handled = 0;
+  uint32_t _inbound_lost_at = 0;
+  std::atomic<bool> _inbound_lost_sync;
+  MQTTNET_NO_UNIQUE_ADDRESS MqttNetOptional<Config::stats, MqttNetMetrics> metrics;
   void onWifiConnect();
   void onWifiDisconnect();
   void onMqttConnect(bool sessionPresent);
-  void onMqttDisconnect(AsyncMqttClientDisconnectReason reason);
-  void onMqttMessage(char* topic, char* payload, AsyncMqttClientMessageProperties properties, size_t len, size_t index, size_t total);
-  void onMqttFileMessage(String action, char* payload, AsyncMqttClientMessageProperties properties, size_t len, size_t index, size_t total);
-  void onMqttString(String topic, String payload, bool retain);
+  void onMqttDisconnect(MqttNetDisconnectReason reason);
+  void onMqttSubscribe(uint16_t packetId, const uint8_t *codes, size_t count);
+  void onMqttMessage(char* topic, char* payload, MqttNetMessageProperties properties, size_t len, size_t index, size_t total);
+  void handleMessage(char* topic, char* payload, MqttNetMessageProperties properties, size_t len, size_t index, size_t total);
+  void inboundHandler();
+  bool isSyncTopic(const char *topic);
+  void onMqttFileMessage(const char *action, char* payload, MqttNetMessageProperties properties, size_t len, size_t index, size_t total, std::true_type);
+  void onMqttFileMessage(const char *action, char* payload, MqttNetMessageProperties properties, size_t len, size_t index, size_t total, std::false_type);
+  void onMqttFetchMessage(const char *action, char* payload, size_t len, size_t index, size_t total, std::true_type);
+  void onMqttFetchMessage(const char *action, char* payload, size_t len, size_t index, size_t total, std::false_type);
+  void onMqttString(const char *topic, const char *payload, bool retain);
+  void abortFetch(std::true_type);
+  void abortFetch(std::false_type) {}
+  void fetchPump(std::true_type);
+  void fetchPump(std::false_type) {}
+  template <typename T>
+  bool addReading(const char *key, T value, std::true_type);
+  template <typename T>
+  bool addReading(const char *, T, std::false_type) { return false; }
+  bool beginBatch(const char *topic, uint8_t qos, bool retain, std::true_type);
+  bool beginBatch(const char *, uint8_t, bool, std::false_type) { return false; }
+  bool flushBatch(MqttNetBatchFlush reason, std::true_type);
+  bool flushBatch(MqttNetBatchFlush, std::false_type) { return false; }
+  template <typename F>
+  void updateMetrics(F update) { updateMetrics(update, stats_enabled()); }
+  template <typename F>
+  void updateMetrics(F update, std::true_type) { update(metrics.value); }
+  template <typename F>
+  void updateMetrics(F, std::false_type) {}
+  const MqttNetHistogram &histogram(MqttNetHistogram MqttNetMetrics::*member, std::true_type) { return metrics.value.*member; }
+  const MqttNetHistogram &histogram(MqttNetHistogram MqttNetMetrics::*, std::false_type);
+  void publishMetrics(std::true_type);
+  void publishMetrics(std::false_type) {}
+  void publishBatchStats(std::true_type);
+  void publishBatchStats(std::false_type) {}
+  bool addFile(char *payload, size_t len, long pos);
+  void onSyncChunk(char *payload, size_t len, size_t index, size_t total);
+  void publishRetry(uint32_t offset, uint32_t length);
+  bool addBundle(char *payload, size_t len);
+  void beginBundle();
+  void recoverBundle(std::true_type);
+  void recoverBundle(std::false_type) {}
+  void abortSync(std::true_type);
+  void abortSync(std::false_type) {}
+  void abortFirmware(std::true_type);
+  void abortFirmware(std::false_type) {}
+  bool addFirmware(char *payload, size_t len, std::true_type);
+  bool addFirmware(char *payload, size_t len, std::false_type);
+  void beginFirmware(std::true_type);
+  void beginFirmware(std::false_type);
+  void clearNewFile();
   void connectToMqtt(bool cleanSession=true);
+  void connectToMqttClean() { connectToMqtt(true); }
+  void reconnectToMqtt() { connectToMqtt(false); }
+  void flushBatchOnTime() { flushBatch(MQTTNET_BATCH_FLUSH_TIME, batch_enabled()); }
   void dequeueHandler();
+  bool dequeueBudgetLeft(unsigned long start, size_t bytes);
+  bool fullTopic(char *full_topic, const char *topic);
+  bool isInternalTopic(const char *topic);
+  uint16_t publishf(const char *topic, uint8_t qos, bool retain, const char *format, ...) __attribute__((format(printf, 5, 6)));
   void publishMetadata();
   void publishStats();
+  bool sendSubscriptions(unsigned long start, size_t &bytes);
+  bool subscriptionsPending();
   void watchdogHandler();
+  // timer callback calling Method on the instance passed as its argument
+  template <void (MqttNetT::*Method)()>
+  static void call(void *self) { (static_cast<MqttNetT*>(self)->*Method)(); }
 
  public:
-  MqttNet();
+#ifdef ARDUINO_ARCH_ESP8266
+  MqttNetT();
+#endif
+  MqttNetT(MqttNetPlatform &platform);
   bool allowRemoteSync = false;
-  mqttnet_connect_callback_t connect_callback;
-  mqttnet_disconnect_callback_t disconnect_callback;
-  mqttnet_file_callback_t file_callback;
-  mqttnet_message_callback_t message_callback;
-  mqttnet_string_callback_t string_callback;
+  bool allowRemoteFetch = false;
+  mqttnet_connect_callback_t connect_callback = nullptr;
+  mqttnet_disconnect_callback_t disconnect_callback = nullptr;
+  mqttnet_file_callback_t file_callback = nullptr;
+  mqttnet_message_callback_t message_callback = nullptr;
+  mqttnet_string_callback_t string_callback = nullptr;
+  // Adds a reading to the batch started by beginBatch(). Integers, floats,
+  // bools and strings are supported, each key should be used once per batch.
+  template <typename T>
+  bool add(const char *key, T value) { return addReading(key, value, batch_enabled()); }
   void begin();
+  bool beginBatch(const char *topic, uint8_t qos = 0, bool retain = false);
+  bool flushBatch();
+  const MqttNetHistogram &dequeueHistogram();
+  const MqttNetHistogram &inboundHistogram();
   bool isConnected();
+  uint16_t publish(const char *topic, uint8_t qos, bool retain, const char *payload, size_t length);
+  uint16_t publish(const char *topic, uint8_t qos, bool retain, const char *payload);
   uint16_t publish(String topic, uint8_t qos, bool retain, String payload);
   bool restartRequired();
   bool restartRequiredForFirmware();
+  void setClientId(const char *clientId);
   void setConfig(const char *host, uint16_t port, bool tls, const char *username, const char *password, const char *prefix);
   void setWatchdog(long timeout);
+  uint16_t subscribe(const char *topic, uint8_t qos);
   uint16_t subscribe(String topic, uint8_t qos);
+  uint16_t unsubscribe(const char *topic);
 };
 
+typedef MqttNetT<MqttNetDefaultConfig> MqttNet;
+
+#include "MqttNetImpl.hpp"
+
 #endif
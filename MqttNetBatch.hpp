@@ -0,0 +1,174 @@
+#ifndef MQTTNETBATCH_HPP
+#define MQTTNETBATCH_HPP
+
+#include "MqttNetCbor.hpp"
+
+enum MqttNetBatchFlush {
+  MQTTNET_BATCH_FLUSH_SIZE,
+  MQTTNET_BATCH_FLUSH_COUNT,
+  MQTTNET_BATCH_FLUSH_TIME,
+  MQTTNET_BATCH_FLUSH_MANUAL,
+  MQTTNET_BATCH_FLUSH_REASONS
+};
+
+// Readings collected into one CBOR map of at most Size bytes, e.g.
+// {"temp": 21.5, "hum": 48} in 18 bytes, plus the counters describing the
+// batches sent so far. The topic is copied, up to TopicSize bytes.
+template <size_t Size, size_t TopicSize>
+class MqttNetBatch {
+ private:
+  uint8_t buffer[Size];
+  MqttNetCborWriter writer;
+  char _topic[TopicSize] = "";
+  uint8_t _qos = 0;
+  bool _retain = false;
+  size_t _readings = 0;
+  uint32_t _flushes[MQTTNET_BATCH_FLUSH_REASONS] = {};
+  uint32_t _total_readings = 0;
+  uint32_t _total_bytes = 0;
+
+  static_assert(Size >= 3, "batch too small");
+
+  // one byte stays reserved for the end of the map
+  template <typename F>
+  bool addWith(const char *key, F write) {
+    size_t mark = writer.size();
+    if (writer.writeText(key, strlen(key)) && write() && writer.size() < Size) {
+      _readings++;
+      return true;
+    }
+    writer.truncate(mark);
+    return false;
+  }
+
+ public:
+  // buffer size that always holds flushes()
+  static const size_t flushes_size = MQTTNET_BATCH_FLUSH_REASONS * 11;
+
+  MqttNetBatch() : writer(buffer, Size) {
+    clear();
+  }
+
+  bool begin(const char *topic, uint8_t qos, bool retain) {
+    if (strlen(topic) >= TopicSize) {
+      return false;
+    }
+    strcpy(_topic, topic);
+    _qos = qos;
+    _retain = retain;
+    return true;
+  }
+
+  bool active() const {
+    return _topic[0] != 0;
+  }
+
+  const char *topic() const {
+    return _topic;
+  }
+
+  uint8_t qos() const {
+    return _qos;
+  }
+
+  bool retain() const {
+    return _retain;
+  }
+
+  size_t readings() const {
+    return _readings;
+  }
+
+  // Adds key and value, returns false and leaves the batch unchanged if
+  // they do not fit.
+  bool add(const char *key, int value) {
+    return add(key, (long long)value);
+  }
+
+  bool add(const char *key, long value) {
+    return add(key, (long long)value);
+  }
+
+  bool add(const char *key, long long value) {
+    return addWith(key, [&]() { return writer.writeInteger(value); });
+  }
+
+  bool add(const char *key, unsigned int value) {
+    return add(key, (unsigned long long)value);
+  }
+
+  bool add(const char *key, unsigned long value) {
+    return add(key, (unsigned long long)value);
+  }
+
+  bool add(const char *key, unsigned long long value) {
+    return addWith(key, [&]() { return writer.writeUnsigned(value); });
+  }
+
+  bool add(const char *key, float value) {
+    return add(key, (double)value);
+  }
+
+  bool add(const char *key, double value) {
+    return addWith(key, [&]() { return writer.writeNumber(value); });
+  }
+
+  bool add(const char *key, bool value) {
+    return addWith(key, [&]() { return writer.writeBool(value); });
+  }
+
+  bool add(const char *key, const char *value) {
+    return addWith(key, [&]() { return writer.writeText(value, strlen(value)); });
+  }
+
+  bool add(const char *key, const String &value) {
+    return addWith(key, [&]() { return writer.writeText(value.c_str(), value.length()); });
+  }
+
+  // Closes the map and returns the payload, valid until clear() or
+  // reopen().
+  const char *finish(size_t *length) {
+    writer.endIndefinite();
+    *length = writer.size();
+    return (const char *)buffer;
+  }
+
+  // takes back finish() when the payload could not be sent
+  void reopen() {
+    writer.truncate(writer.size() - 1);
+  }
+
+  void clear() {
+    writer.truncate(0);
+    writer.beginIndefiniteMap();
+    _readings = 0;
+  }
+
+  // counts the finished batch as sent
+  void countFlush(MqttNetBatchFlush reason) {
+    _flushes[reason]++;
+    _total_readings += _readings;
+    _total_bytes += writer.size();
+  }
+
+  // writes the comma separated flush counts by reason (size, count, time,
+  // manual) to buffer and returns their length
+  size_t flushes(char *buffer, size_t size) const {
+    size_t len = 0;
+    buffer[0] = 0;
+    for (size_t i = 0; i < MQTTNET_BATCH_FLUSH_REASONS && len < size; i++) {
+      len += snprintf(buffer + len, size - len, i > 0 ? ",%lu" : "%lu", (unsigned long)_flushes[i]);
+    }
+    return len < size ? len : size - 1;
+  }
+
+  uint32_t totalReadings() const {
+    return _total_readings;
+  }
+
+  uint32_t totalBytes() const {
+    return _total_bytes;
+  }
+};
+
+#endif
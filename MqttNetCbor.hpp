@@ -0,0 +1,121 @@
+#ifndef MQTTNETCBOR_HPP
+#define MQTTNETCBOR_HPP
+
+#include "MqttNetPlatform.hpp"
+
+// Minimal CBOR (RFC 8949) encoder writing into a caller supplied buffer.
+// Every write either fits completely or leaves the buffer unchanged and
+// returns false.
+class MqttNetCborWriter {
+ private:
+  uint8_t *buffer;
+  size_t capacity;
+  size_t used = 0;
+
+  bool head(uint8_t major, uint64_t value, size_t extra) {
+    uint8_t bytes;
+    if (value < 24) {
+      bytes = 0;
+    } else if (value <= 0xff) {
+      bytes = 1;
+    } else if (value <= 0xffff) {
+      bytes = 2;
+    } else if (value <= 0xffffffffUL) {
+      bytes = 4;
+    } else {
+      bytes = 8;
+    }
+    if (used + 1 + bytes + extra > capacity) {
+      return false;
+    }
+    static const uint8_t info[] = {0, 24, 25, 0, 26, 0, 0, 0, 27};
+    buffer[used++] = (major << 5) | (bytes == 0 ? value : info[bytes]);
+    for (int i = bytes - 1; i >= 0; i--) {
+      buffer[used++] = value >> (8 * i);
+    }
+    return true;
+  }
+
+ public:
+  MqttNetCborWriter(uint8_t *buffer, size_t capacity) : buffer(buffer), capacity(capacity) {}
+
+  size_t size() const {
+    return used;
+  }
+
+  // drops everything written after size() returned length
+  void truncate(size_t length) {
+    used = length;
+  }
+
+  bool beginIndefiniteMap() {
+    if (used + 1 > capacity) {
+      return false;
+    }
+    buffer[used++] = 0xbf;
+    return true;
+  }
+
+  bool endIndefinite() {
+    if (used + 1 > capacity) {
+      return false;
+    }
+    buffer[used++] = 0xff;
+    return true;
+  }
+
+  bool writeUnsigned(uint64_t value) {
+    return head(0, value, 0);
+  }
+
+  bool writeInteger(int64_t value) {
+    if (value >= 0) {
+      return head(0, value, 0);
+    }
+    return head(1, -1 - value, 0);
+  }
+
+  bool writeText(const char *text, size_t length) {
+    if (!head(3, length, length)) {
+      return false;
+    }
+    memcpy(buffer + used, text, length);
+    used += length;
+    return true;
+  }
+
+  bool writeBool(bool value) {
+    if (used + 1 > capacity) {
+      return false;
+    }
+    buffer[used++] = value ? 0xf5 : 0xf4;
+    return true;
+  }
+
+  // integral values as integers, others as float32 when that is exact
+  bool writeNumber(double value) {
+    if (value >= -9.2e18 && value <= 9.2e18 && value == (double)(int64_t)value) {
+      return writeInteger((int64_t)value);
+    }
+    float f = value;
+    uint8_t bytes = (double)f == value || value != value ? 4 : 8;
+    if (used + 1 + bytes > capacity) {
+      return false;
+    }
+    uint64_t bits;
+    if (bytes == 4) {
+      uint32_t bits32;
+      memcpy(&bits32, &f, 4);
+      bits = bits32;
+    } else {
+      memcpy(&bits, &value, 8);
+    }
+    buffer[used++] = bytes == 4 ? 0xfa : 0xfb;
+    for (int i = bytes - 1; i >= 0; i--) {
+      buffer[used++] = bits >> (8 * i);
+    }
+    return true;
+  }
+};
+
+#endif
@@ -0,0 +1,203 @@
+#ifndef MQTTNETCHUNKS_HPP
+#define MQTTNETCHUNKS_HPP
+
+#include "MqttNetCrc32.hpp"
+
+enum MqttNetChunkResult {
+  MQTTNET_CHUNK_PARTIAL,
+  MQTTNET_CHUNK_COMPLETE,
+  MQTTNET_CHUNK_MALFORMED,
+  MQTTNET_CHUNK_BAD_CRC,
+  MQTTNET_CHUNK_NO_HEADER
+};
+
+enum MqttNetChunkPlacement {
+  MQTTNET_CHUNK_ACCEPT,
+  MQTTNET_CHUNK_GAP,
+  MQTTNET_CHUNK_DUPLICATE,
+  MQTTNET_CHUNK_REJECT
+};
+
+// Receives checked sync chunks: a 4 byte offset, the CRC32 of offset and
+// data (both big endian) and up to Size bytes of data. A message delivered
+// in pieces is collected first, so nothing is written before its CRC is
+// verified. Ranges that were skipped, because a chunk failed its check or
+// got lost, are remembered as holes (at most Holes) until they are sent
+// again, which lets a sender retransmit just those ranges.
+template <size_t Size, size_t Holes = 8>
+class MqttNetChunkReceiver {
+ private:
+  static const size_t header_size = 8;
+  struct Range {
+    uint32_t offset;
+    uint32_t length;
+  };
+  uint8_t buffer[header_size + Size];
+  // bytes of the current message received so far, and of its header
+  size_t received = 0;
+  size_t header_received = 0;
+  size_t size = 0;
+  uint32_t high = 0;
+  Range holes[Holes];
+  size_t hole_count = 0;
+  // where place() put the current chunk: a hole, or Holes for the end
+  size_t placed = Holes;
+
+  static uint32_t readUint32(const uint8_t *at) {
+    return ((uint32_t)at[0] << 24) | ((uint32_t)at[1] << 16) | ((uint32_t)at[2] << 8) | at[3];
+  }
+
+  bool addHole(uint32_t offset, uint32_t length) {
+    if (length == 0) {
+      return true;
+    }
+    if (hole_count == Holes) {
+      return false;
+    }
+    holes[hole_count].offset = offset;
+    holes[hole_count].length = length;
+    hole_count++;
+    return true;
+  }
+
+ public:
+  // forgets all chunks, for a new transfer
+  void reset() {
+    received = 0;
+    header_received = 0;
+    size = 0;
+    high = 0;
+    hole_count = 0;
+  }
+
+  // Collects the pieces of one message, index and total as passed to the
+  // message callback. A message missing pieces is a BAD_CRC, or NO_HEADER
+  // when the missing pieces include its offset.
+  MqttNetChunkResult collect(const uint8_t *piece, size_t len, size_t index, size_t total) {
+    if (total < header_size || total > sizeof(buffer) || index + len > total) {
+      return MQTTNET_CHUNK_MALFORMED;
+    }
+    if (index == 0) {
+      received = 0;
+      header_received = 0;
+    }
+    memcpy(buffer + index, piece, len);
+    received += len;
+    if (index < header_size) {
+      header_received += len < header_size - index ? len : header_size - index;
+    }
+    if (index + len < total) {
+      return MQTTNET_CHUNK_PARTIAL;
+    }
+    bool complete = received == total;
+    bool header = header_received == header_size;
+    received = 0;
+    header_received = 0;
+    size = total - header_size;
+    if (!complete) {
+      return header ? MQTTNET_CHUNK_BAD_CRC : MQTTNET_CHUNK_NO_HEADER;
+    }
+    uint32_t crc = mqttnet_crc32(buffer, 4);
+    crc = mqttnet_crc32(data(), length(), crc);
+    return crc == readUint32(buffer + 4) ? MQTTNET_CHUNK_COMPLETE : MQTTNET_CHUNK_BAD_CRC;
+  }
+
+  uint32_t offset() const {
+    return readUint32(buffer);
+  }
+
+  uint8_t *data() {
+    return buffer + header_size;
+  }
+
+  size_t length() const {
+    return size;
+  }
+
+  // whether the collected chunk lies within the first size bytes; written
+  // so that offset + length cannot wrap around on 32 bit targets
+  bool within(size_t size) const {
+    return offset() <= size && length() <= size - offset();
+  }
+
+  // Decides what to do with the collected chunk. Positional writers accept
+  // chunks anywhere, leaving a hole when one skips ahead (GAP, with the
+  // hole in retry); sequential writers only accept the next chunk and
+  // REJECT others with the range to send again. Chunks already written are
+  // DUPLICATEs. Nothing changes until commit() is called for an accepted
+  // chunk, once it has been written.
+  MqttNetChunkPlacement place(bool positional, uint32_t *retry_offset, uint32_t *retry_length) {
+    uint32_t start = offset();
+    uint32_t end = start + length();
+    placed = Holes;
+    if (start == high) {
+      return MQTTNET_CHUNK_ACCEPT;
+    }
+    if (start > high) {
+      *retry_offset = high;
+      *retry_length = start - high;
+      if (!positional || hole_count == Holes) {
+        *retry_length = end - high;
+        return MQTTNET_CHUNK_REJECT;
+      }
+      return MQTTNET_CHUNK_GAP;
+    }
+    for (size_t i = 0; positional && i < hole_count; i++) {
+      Range hole = holes[i];
+      if (start >= hole.offset && end <= hole.offset + hole.length) {
+        // splitting the hole needs another entry; sent again from the start
+        // of the hole, the chunk would only shrink it
+        if (start > hole.offset && end < hole.offset + hole.length && hole_count == Holes) {
+          *retry_offset = hole.offset;
+          *retry_length = end - hole.offset;
+          return MQTTNET_CHUNK_REJECT;
+        }
+        placed = i;
+        return MQTTNET_CHUNK_ACCEPT;
+      }
+    }
+    return MQTTNET_CHUNK_DUPLICATE;
+  }
+
+  // marks the chunk accepted by place() as received
+  void commit() {
+    uint32_t start = offset();
+    uint32_t end = start + length();
+    if (placed == Holes) {
+      addHole(high, start - high);
+      high = end;
+      return;
+    }
+    Range hole = holes[placed];
+    holes[placed] = holes[--hole_count];
+    addHole(hole.offset, start - hole.offset);
+    addHole(end, hole.offset + hole.length - end);
+  }
+
+  // the range a chunk without its offset most likely covered: the first
+  // hole, or else the range following the highest chunk
+  void expected(uint32_t *offset, uint32_t *length) const {
+    if (!missing(offset, length)) {
+      *offset = high;
+      *length = size;
+    }
+  }
+
+  // the first range still missing, if any
+  bool missing(uint32_t *offset, uint32_t *length) const {
+    if (hole_count == 0) {
+      return false;
+    }
+    size_t first = 0;
+    for (size_t i = 1; i < hole_count; i++) {
+      if (holes[i].offset < holes[first].offset) {
+        first = i;
+      }
+    }
+    *offset = holes[first].offset;
+    *length = holes[first].length;
+    return true;
+  }
+};
+
+#endif
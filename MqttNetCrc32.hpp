@@ -0,0 +1,23 @@
+#ifndef MQTTNETCRC32_HPP
+#define MQTTNETCRC32_HPP
+
+#include "MqttNetPlatform.hpp"
+
+// CRC-32 as used by zlib and Ethernet (reflected, polynomial 0xedb88320),
+// with a 16 entry table to keep flash usage small. Chains like zlib's
+// crc32(): mqttnet_crc32(b, n, mqttnet_crc32(a, m)) is the CRC of a then b.
+inline uint32_t mqttnet_crc32(const uint8_t *data, size_t len, uint32_t crc = 0) {
+  static const uint32_t table[16] = {
+    0x00000000, 0x1db71064, 0x3b6e20c8, 0x26d930ac, 0x76dc4190, 0x6b6b51f4, 0x4db26158, 0x5005713c,
+    0xedb88320, 0xf00f9344, 0xd6d6a3e8, 0xcb61b38c, 0x9b64c2b0, 0x86d3d2d4, 0xa00ae278, 0xbdbdf21c,
+  };
+  crc = ~crc;
+  for (size_t i = 0; i < len; i++) {
+    crc ^= data[i];
+    crc = (crc >> 4) ^ table[crc & 0x0f];
+    crc = (crc >> 4) ^ table[crc & 0x0f];
+  }
+  return ~crc;
+}
+
+#endif
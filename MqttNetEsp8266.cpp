@@ -0,0 +1,242 @@
+#include "MqttNetEsp8266.hpp"
+
+#ifdef ARDUINO_ARCH_ESP8266
+
+#if MQTTNET_ESP8266_LITTLEFS
+#include <LittleFS.h>
+#endif
+
+void MqttNetEsp8266Client::onConnect(connect_handler_t handler) {
+  client.onConnect(handler);
+}
+
+void MqttNetEsp8266Client::onDisconnect(disconnect_handler_t handler) {
+  client.onDisconnect(handler);
+}
+
+void MqttNetEsp8266Client::onMessage(message_handler_t handler) {
+  client.onMessage(handler);
+}
+
+// AsyncMqttClient sends one filter per SUBSCRIBE, its SUBACK has one code
+void MqttNetEsp8266Client::onSubscribe(subscribe_handler_t handler) {
+  client.onSubscribe([handler](uint16_t packetId, uint8_t qos) { handler(packetId, &qos, 1); });
+}
+
+void MqttNetEsp8266Client::setClientId(const char *clientId) {
+  client.setClientId(clientId);
+}
+
+void MqttNetEsp8266Client::setServer(const char *host, uint16_t port) {
+  client.setServer(host, port);
+}
+
+void MqttNetEsp8266Client::setSecure(bool secure) {
+  client.setSecure(secure);
+}
+
+void MqttNetEsp8266Client::setCredentials(const char *username, const char *password) {
+  client.setCredentials(username, password);
+}
+
+void MqttNetEsp8266Client::setWill(const char *topic, uint8_t qos, bool retain, const char *payload) {
+  client.setWill(topic, qos, retain, payload);
+}
+
+void MqttNetEsp8266Client::setCleanSession(bool cleanSession) {
+  client.setCleanSession(cleanSession);
+}
+
+void MqttNetEsp8266Client::connect() {
+  client.connect();
+}
+
+void MqttNetEsp8266Client::disconnect() {
+  client.disconnect();
+}
+
+bool MqttNetEsp8266Client::connected() {
+  return client.connected();
+}
+
+uint16_t MqttNetEsp8266Client::subscribe(const char *topic, uint8_t qos) {
+  return client.subscribe(topic, qos);
+}
+
+uint16_t MqttNetEsp8266Client::unsubscribe(const char *topic) {
+  return client.unsubscribe(topic);
+}
+
+uint16_t MqttNetEsp8266Client::publish(const char *topic, uint8_t qos, bool retain, const char *payload, size_t length) {
+  return client.publish(topic, qos, retain, payload, length);
+}
+
+// The tick runs in timer context and only schedules run(), which then calls
+// the callback from the main loop. Ticker's own _scheduled variants wrap the
+// callback into a new std::function on every attach and every tick; the
+// argument variants used here and a lambda capturing one pointer do not
+// allocate. A tick while the previous one is still pending is skipped.
+void MqttNetEsp8266Timer::tick(MqttNetEsp8266Timer *timer) {
+  if (!timer->pending) {
+    timer->pending = true;
+    schedule_function([timer]() { timer->run(); });
+  }
+}
+
+void MqttNetEsp8266Timer::run() {
+  pending = false;
+  if (callback) {
+    callback(arg);
+  }
+}
+
+void MqttNetEsp8266Timer::attach_ms_scheduled(uint32_t milliseconds, callback_t callback, void *arg) {
+  this->callback = callback;
+  this->arg = arg;
+  ticker.attach_ms(milliseconds, &MqttNetEsp8266Timer::tick, this);
+}
+
+void MqttNetEsp8266Timer::once_ms_scheduled(uint32_t milliseconds, callback_t callback, void *arg) {
+  this->callback = callback;
+  this->arg = arg;
+  ticker.once_ms(milliseconds, &MqttNetEsp8266Timer::tick, this);
+}
+
+void MqttNetEsp8266Timer::detach() {
+  ticker.detach();
+}
+
+void MqttNetEsp8266Network::onConnect(event_handler_t handler) {
+  wifiConnectHandler = WiFi.onStationModeGotIP([handler](const WiFiEventStationModeGotIP&) { handler(); });
+}
+
+void MqttNetEsp8266Network::onDisconnect(event_handler_t handler) {
+  wifiDisconnectHandler = WiFi.onStationModeDisconnected([handler](const WiFiEventStationModeDisconnected&) { handler(); });
+}
+
+bool MqttNetEsp8266Network::isConnected() {
+  return WiFi.isConnected();
+}
+
+String MqttNetEsp8266Network::localAddress() {
+  return WiFi.localIP().toString();
+}
+
+MqttNetFsStorage::MqttNetFsStorage(fs::FS &fs, bool littlefs) : fs(fs), littlefs(littlefs) {
+}
+
+int MqttNetFsStorage::open(const char *path, const char *mode) {
+  if (!littlefs && strlen(path) >= 32) {
+    Serial.println("MqttNet: file name too long for SPIFFS");
+    return -1;
+  }
+  for (int i = 0; i < MQTTNET_ESP8266_FILES; i++) {
+    if (!files[i]) {
+      files[i] = fs.open(path, mode);
+      return files[i] ? i : -1;
+    }
+  }
+  Serial.println("MqttNet: no free file handle");
+  return -1;
+}
+
+size_t MqttNetFsStorage::read(int handle, uint8_t *data, size_t len) {
+  return files[handle].read(data, len);
+}
+
+size_t MqttNetFsStorage::write(int handle, const uint8_t *data, size_t len) {
+  return files[handle].write(data, len);
+}
+
+bool MqttNetFsStorage::seek(int handle, size_t pos) {
+  return files[handle].seek(pos, SeekSet);
+}
+
+size_t MqttNetFsStorage::size(int handle) {
+  return files[handle].size();
+}
+
+void MqttNetFsStorage::close(int handle) {
+  files[handle].close();
+}
+
+bool MqttNetFsStorage::exists(const char *path) {
+  return fs.exists(path);
+}
+
+bool MqttNetFsStorage::remove(const char *path) {
+  return fs.remove(path);
+}
+
+bool MqttNetFsStorage::rename(const char *from, const char *to) {
+  return fs.rename(from, to);
+}
+
+bool MqttNetFsStorage::mkdir(const char *path) {
+  if (!littlefs) {
+    return false;
+  }
+  char parent[MQTTNET_FILENAME_MAX];
+  for (const char *slash = strchr(path + 1, '/'); slash; slash = strchr(slash + 1, '/')) {
+    if ((size_t)(slash - path) >= sizeof(parent)) {
+      return false;
+    }
+    memcpy(parent, path, slash - path);
+    parent[slash - path] = 0;
+    fs.mkdir(parent);
+  }
+  return fs.mkdir(path) || fs.exists(path);
+}
+
+bool MqttNetFsStorage::renameReplaces() {
+  return littlefs;
+}
+
+#if MQTTNET_ESP8266_LITTLEFS
+MqttNetEsp8266::MqttNetEsp8266() : _storage(LittleFS, true) {
+}
+#else
+MqttNetEsp8266::MqttNetEsp8266() : _storage(SPIFFS, false) {
+}
+#endif
+
+MqttNetEsp8266 &MqttNetEsp8266::instance() {
+  static MqttNetEsp8266 platform;
+  return platform;
+}
+
+MqttNetClient &MqttNetEsp8266::client() {
+  return _client;
+}
+
+MqttNetTimer &MqttNetEsp8266::timer(MqttNetTimerId id) {
+  return _timers[id];
+}
+
+MqttNetNetwork &MqttNetEsp8266::network() {
+  return _network;
+}
+
+MqttNetStorage &MqttNetEsp8266::storage() {
+  return _storage;
+}
+
+void MqttNetEsp8266::publishMetadata(publish_t publish) {
+  publish("net/esp/boot_mode", String(ESP.getBootMode()));
+  publish("net/esp/boot_version", String(ESP.getBootVersion()));
+  publish("net/esp/chip_id", String(ESP.getChipId()));
+  publish("net/esp/core_version", String(ESP.getCoreVersion()));
+  publish("net/esp/cpu_freq_mhz", String(ESP.getCpuFreqMHz()));
+  publish("net/esp/reset_info", String(ESP.getResetInfo()));
+  publish("net/esp/reset_reason", String(ESP.getResetReason()));
+  publish("net/esp/sdk_version", String(ESP.getSdkVersion()));
+  publish("net/esp/sketch_md5", String(ESP.getSketchMD5()));
+  publish("net/esp/sketch_size", String(ESP.getSketchSize()));
+}
+
+void MqttNetEsp8266::publishStats(publish_t publish) {
+  publish("net/esp/free_heap", String(ESP.getFreeHeap()));
+  publish("net/esp/free_cont_stack", String(ESP.getFreeContStack()));
+}
+
+#endif
@@ -0,0 +1,119 @@
+#ifndef MQTTNETESP8266_HPP
+#define MQTTNETESP8266_HPP
+
+#ifdef ARDUINO_ARCH_ESP8266
+
+#include <AsyncMqttClient.h>
+#include <ESP8266WiFi.h>
+#include <FS.h>
+#include <Schedule.h>
+#include <Ticker.h>
+
+#include "MqttNetPlatform.hpp"
+
+#define MQTTNET_ESP8266_FILES 4
+
+// 1 to store files on LittleFS instead of SPIFFS, as a build flag so that
+// only the chosen file system is linked
+#ifndef MQTTNET_ESP8266_LITTLEFS
+#define MQTTNET_ESP8266_LITTLEFS 0
+#endif
+
+class MqttNetEsp8266Client : public MqttNetClient {
+ private:
+  AsyncMqttClient client;
+
+ public:
+  using MqttNetClient::subscribe;
+  void onConnect(connect_handler_t handler);
+  void onDisconnect(disconnect_handler_t handler);
+  void onMessage(message_handler_t handler);
+  void onSubscribe(subscribe_handler_t handler);
+  void setClientId(const char *clientId);
+  void setServer(const char *host, uint16_t port);
+  void setSecure(bool secure);
+  void setCredentials(const char *username, const char *password);
+  void setWill(const char *topic, uint8_t qos, bool retain, const char *payload);
+  void setCleanSession(bool cleanSession);
+  void connect();
+  void disconnect();
+  bool connected();
+  uint16_t subscribe(const char *topic, uint8_t qos);
+  uint16_t unsubscribe(const char *topic);
+  uint16_t publish(const char *topic, uint8_t qos, bool retain, const char *payload, size_t length);
+};
+
+class MqttNetEsp8266Timer : public MqttNetTimer {
+ private:
+  Ticker ticker;
+  callback_t callback = nullptr;
+  void *arg = nullptr;
+  volatile bool pending = false;
+  static void tick(MqttNetEsp8266Timer *timer);
+  void run();
+
+ public:
+  void attach_ms_scheduled(uint32_t milliseconds, callback_t callback, void *arg);
+  void once_ms_scheduled(uint32_t milliseconds, callback_t callback, void *arg);
+  void detach();
+};
+
+class MqttNetEsp8266Network : public MqttNetNetwork {
+ private:
+  WiFiEventHandler wifiConnectHandler;
+  WiFiEventHandler wifiDisconnectHandler;
+
+ public:
+  void onConnect(event_handler_t handler);
+  void onDisconnect(event_handler_t handler);
+  bool isConnected();
+  String localAddress();
+};
+
+// Any file system of the ESP8266 core. SPIFFS has flat names of at most 31
+// characters and cannot rename onto an existing file; LittleFS has
+// directories and replaces the target of a rename atomically.
+class MqttNetFsStorage : public MqttNetStorage {
+ private:
+  fs::FS &fs;
+  bool littlefs;
+  File files[MQTTNET_ESP8266_FILES];
+
+ public:
+  MqttNetFsStorage(fs::FS &fs, bool littlefs);
+  int open(const char *path, const char *mode);
+  size_t read(int handle, uint8_t *data, size_t len);
+  size_t write(int handle, const uint8_t *data, size_t len);
+  bool seek(int handle, size_t pos);
+  size_t size(int handle);
+  void close(int handle);
+  bool exists(const char *path);
+  bool remove(const char *path);
+  bool rename(const char *from, const char *to);
+  bool mkdir(const char *path);
+  bool renameReplaces();
+};
+
+// Uses SPIFFS, or LittleFS with MQTTNET_ESP8266_LITTLEFS. The file system
+// itself is mounted by the sketch.
+class MqttNetEsp8266 : public MqttNetPlatform {
+ private:
+  MqttNetEsp8266Client _client;
+  MqttNetEsp8266Timer _timers[MQTTNET_TIMER_COUNT];
+  MqttNetEsp8266Network _network;
+  MqttNetFsStorage _storage;
+
+ public:
+  MqttNetEsp8266();
+  static MqttNetEsp8266 &instance();
+  MqttNetClient &client();
+  MqttNetTimer &timer(MqttNetTimerId id);
+  MqttNetNetwork &network();
+  MqttNetStorage &storage();
+  void publishMetadata(publish_t publish);
+  void publishStats(publish_t publish);
+};
+
+#endif
+
+#endif
@@ -0,0 +1,60 @@
+#ifndef MQTTNETHISTOGRAM_HPP
+#define MQTTNETHISTOGRAM_HPP
+
+#include "MqttNetPlatform.hpp"
+
+// Fixed bucket latency histogram in microseconds. Bucket i counts samples
+// up to bound(i), the last bucket everything above.
+class MqttNetHistogram {
+ public:
+  static const size_t buckets = 9;
+  // buffer size that always holds format()
+  static const size_t format_size = buckets * 11;
+
+ private:
+  uint32_t counts[buckets] = {};
+  uint32_t maximum = 0;
+
+ public:
+  static uint32_t bound(size_t bucket) {
+    static const uint32_t bounds[buckets] = {100, 250, 500, 1000, 2500, 5000, 10000, 25000, UINT32_MAX};
+    return bounds[bucket];
+  }
+
+  void add(uint32_t us) {
+    size_t i = 0;
+    while (us > bound(i)) {
+      i++;
+    }
+    counts[i]++;
+    if (us > maximum) {
+      maximum = us;
+    }
+  }
+
+  uint32_t count(size_t bucket) const {
+    return counts[bucket];
+  }
+
+  uint32_t max() const {
+    return maximum;
+  }
+
+  void clear() {
+    memset(counts, 0, sizeof(counts));
+    maximum = 0;
+  }
+
+  // writes the comma separated bucket counts, e.g. "12,3,0,0,0,0,0,0,0",
+  // to buffer and returns their length
+  size_t format(char *buffer, size_t size) const {
+    size_t len = 0;
+    buffer[0] = 0;
+    for (size_t i = 0; i < buckets && len < size; i++) {
+      len += snprintf(buffer + len, size - len, i > 0 ? ",%lu" : "%lu", (unsigned long)counts[i]);
+    }
+    return len < size ? len : size - 1;
+  }
+};
+
+#endif
@@ -0,0 +1,1139 @@
+#ifndef MQTTNETIMPL_HPP
+#define MQTTNETIMPL_HPP
+
+// Member definitions of MqttNetT, included by MqttNet.hpp.
+
+#ifdef ARDUINO_ARCH_ESP8266
+#include "MqttNetEsp8266.hpp"
+
+template <typename Config>
+MqttNetT<Config>::MqttNetT() : MqttNetT(MqttNetEsp8266::instance()) {
+}
+#endif
+
+template <typename Config>
+MqttNetT<Config>::MqttNetT(MqttNetPlatform &platform) :
+    platform(platform),
+    mqttClient(&platform.client()),
+    mqttReconnectTimer(platform.timer(MQTTNET_TIMER_RECONNECT)),
+    dequeueTicker(platform.timer(MQTTNET_TIMER_DEQUEUE)),
+    dequeueResumeTimer(platform.timer(MQTTNET_TIMER_DEQUEUE_RESUME)),
+    inboundTimer(platform.timer(MQTTNET_TIMER_INBOUND)),
+    batchTimer(platform.timer(MQTTNET_TIMER_BATCH)),
+    statsTicker(platform.timer(MQTTNET_TIMER_STATS)),
+    watchdogTicker(platform.timer(MQTTNET_TIMER_WATCHDOG)),
+    network(platform.network()),
+    fileWriter(&platform.storage()),
+    bundleWriter(&platform.storage()),
+    fileReader(&platform.storage()),
+    _inbound_paused(false),
+    _inbound_lost_sync(false) {
+  static_assert(Config::max_topic + Config::max_payload + 7 <= Config::publish_pool, "publish_pool cannot hold a message of max_topic and max_payload");
+  static_assert(Config::max_topic <= Config::subscription_pool, "subscription_pool cannot hold a topic of max_topic");
+  static_assert(Config::max_topic + 4 <= Config::max_subscribe_packet, "max_subscribe_packet cannot hold a topic of max_topic");
+  static_assert(inbound_resume < Config::inbound_pool, "inbound_pool too small for inbound_chunk");
+  static_assert(!Config::batch || Config::batch_size <= Config::max_payload, "batch_size exceeds max_payload");
+  static_assert(!Config::fetch || Config::max_payload > 4, "max_payload too small for net/fetch/data");
+  static_assert(!Config::firmware || MQTTNET_FIRMWARE, "firmware updates are not supported on this platform");
+  static_assert(Config::ram_budget == 0 || sizeof(MqttNetT<Config>) <= Config::ram_budget, "MqttNetT<Config> exceeds Config::ram_budget");
+  using namespace std::placeholders;
+  clearNewFile();
+  network.onConnect(std::bind(&MqttNetT::onWifiConnect, this));
+  network.onDisconnect(std::bind(&MqttNetT::onWifiDisconnect, this));
+  mqttClient->onConnect(std::bind(&MqttNetT::onMqttConnect, this, _1));
+  mqttClient->onDisconnect(std::bind(&MqttNetT::onMqttDisconnect, this, _1));
+  mqttClient->onMessage(std::bind(&MqttNetT::onMqttMessage, this, _1, _2, _3, _4, _5, _6));
+  mqttClient->onSubscribe(std::bind(&MqttNetT::onMqttSubscribe, this, _1, _2, _3));
+}
+
+template <typename Config>
+void MqttNetT<Config>::begin() {
+  recoverBundle(sync_enabled());
+  watchdogTicker.attach_ms_scheduled(1000, call<&MqttNetT::watchdogHandler>, this);
+  dequeueTicker.attach_ms_scheduled(Config::dequeue_interval, call<&MqttNetT::dequeueHandler>, this);
+  if (Config::stats) {
+    statsTicker.attach_ms_scheduled(Config::stats_interval, call<&MqttNetT::publishStats>, this);
+  }
+  if (network.isConnected()) {
+    connectToMqtt(true);
+  } else {
+    mqttReconnectTimer.once_ms_scheduled(1000, call<&MqttNetT::connectToMqttClean>, this);
+  }
+}
+
+template <typename Config>
+template <typename T>
+bool MqttNetT<Config>::addReading(const char *key, T value, std::true_type) {
+  MqttNetBatch<Config::batch_size, Config::max_topic> &batch = this->batch.value;
+  if (!batch.active()) {
+    return false;
+  }
+  if (!batch.add(key, value)) {
+    if (batch.readings() == 0) {
+      return false;
+    }
+    flushBatch(MQTTNET_BATCH_FLUSH_SIZE, batch_enabled());
+    if (!batch.add(key, value)) {
+      return false;
+    }
+  }
+  if (batch.readings() == 1) {
+    batchTimer.once_ms_scheduled(Config::batch_interval, call<&MqttNetT::flushBatchOnTime>, this);
+  }
+  if (batch.readings() >= Config::batch_count) {
+    flushBatch(MQTTNET_BATCH_FLUSH_COUNT, batch_enabled());
+  }
+  return true;
+}
+
+template <typename Config>
+bool MqttNetT<Config>::beginBatch(const char *topic, uint8_t qos, bool retain) {
+  return beginBatch(topic, qos, retain, batch_enabled());
+}
+
+template <typename Config>
+bool MqttNetT<Config>::beginBatch(const char *topic, uint8_t qos, bool retain, std::true_type) {
+  // pending readings stay with their topic until they are sent
+  if (!flushBatch(MQTTNET_BATCH_FLUSH_MANUAL, batch_enabled())) {
+    return false;
+  }
+  return batch.value.begin(topic, qos, retain);
+}
+
+template <typename Config>
+bool MqttNetT<Config>::flushBatch() {
+  return flushBatch(MQTTNET_BATCH_FLUSH_MANUAL, batch_enabled());
+}
+
+template <typename Config>
+bool MqttNetT<Config>::flushBatch(MqttNetBatchFlush reason, std::true_type) {
+  MqttNetBatch<Config::batch_size, Config::max_topic> &batch = this->batch.value;
+  batchTimer.detach();
+  if (batch.readings() == 0) {
+    return true;
+  }
+  size_t length;
+  const char *payload = batch.finish(&length);
+  if (!publish(batch.topic(), batch.qos(), batch.retain(), payload, length)) {
+    // keep the readings and try again later, add() fails once the batch
+    // is full
+    batch.reopen();
+    batchTimer.once_ms_scheduled(Config::batch_interval, call<&MqttNetT::flushBatchOnTime>, this);
+    return false;
+  }
+  batch.countFlush(reason);
+  batch.clear();
+  return true;
+}
+
+template <typename Config>
+void MqttNetT<Config>::clearNewFile() {
+  newFileName[0] = 0;
+  newFileMD5[0] = 0;
+  newFileSize = -1;
+}
+
+template <typename Config>
+void MqttNetT<Config>::connectToMqtt(bool cleanSession) {
+  snprintf(will_topic, sizeof(will_topic), "%s/net/connected", mqtt_prefix);
+  mqttClient->setWill(will_topic, 0, 1, "0");
+  if (clientid) {
+    mqttClient->setClientId(clientid);
+  }
+  mqttClient->setServer(mqtt_host, mqtt_port);
+  mqttClient->setSecure(mqtt_tls);
+  if (strlen(mqtt_username) > 0 && strlen(mqtt_password) > 0) {
+    mqttClient->setCredentials(mqtt_username, mqtt_password);
+  }
+  mqttClient->setCleanSession(cleanSession);
+  mqttClient->connect();
+}
+
+template <typename Config>
+void MqttNetT<Config>::dequeueHandler() {
+  if (!mqttClient->connected()) {
+    dequeueResumeTimer.detach();
+    pubqueue.clear();
+    return;
+  }
+  bool pending = subscriptionsPending();
+  if (!pending && pubqueue.empty()) {
+    return;
+  }
+  unsigned long start = micros();
+  size_t bytes = 0;
+  MqttNetMessage message;
+  if (pending) {
+    if (!sendSubscriptions(start, bytes)) {
+      updateMetrics([&](MqttNetMetrics &m) { m.dequeue_us.add(micros() - start); });
+      return;
+    }
+    pending = subscriptionsPending();
+  }
+  while (!pending && pubqueue.front(message)) {
+    if (!dequeueBudgetLeft(start, bytes)) {
+      break;
+    }
+    if (mqttClient->publish(message.topic, 0, message.retain, message.payload, message.length)) {
+      bytes += strlen(message.topic) + message.length;
+      pubqueue.pop();
+    } else {
+      updateMetrics([&](MqttNetMetrics &m) { m.dequeue_us.add(micros() - start); });
+      return;
+    }
+  }
+  fetchPump(fetch_enabled());
+  updateMetrics([&](MqttNetMetrics &m) { m.dequeue_us.add(micros() - start); });
+  if (pending || !pubqueue.empty()) {
+    // out of budget: continue from the main loop right after loop() had its
+    // turn instead of waiting for the next tick
+    dequeueResumeTimer.once_ms_scheduled(0, call<&MqttNetT::dequeueHandler>, this);
+  }
+}
+
+template <typename Config>
+bool MqttNetT<Config>::dequeueBudgetLeft(unsigned long start, size_t bytes) {
+  if (bytes == 0) {
+    return true;
+  }
+  return micros() - start < Config::dequeue_budget_us && bytes < Config::dequeue_budget_bytes;
+}
+
+template <typename Config>
+bool MqttNetT<Config>::sendSubscriptions(unsigned long start, size_t &bytes) {
+  for (size_t i = 0; i < subscriptions.size(); ) {
+    if (subscriptions.state(i) != subscription_table_t::UNSUBSCRIBE) {
+      i++;
+      continue;
+    }
+    if (!dequeueBudgetLeft(start, bytes)) {
+      return true;
+    }
+    if (!mqttClient->unsubscribe(subscriptions.topic(i))) {
+      return false;
+    }
+    bytes += strlen(subscriptions.topic(i));
+    subscriptions.remove(i);
+  }
+
+  // as many pending filters per SUBSCRIBE as fit into max_subscribe_packet
+  const char *topics[Config::subscriptions];
+  uint8_t qos[Config::subscriptions];
+  uint16_t ids[Config::subscriptions];
+  while (dequeueBudgetLeft(start, bytes)) {
+    size_t count = 0;
+    size_t packet = 2;
+    for (size_t i = 0; i < subscriptions.size(); i++) {
+      if (subscriptions.state(i) != subscription_table_t::PENDING) {
+        continue;
+      }
+      size_t len = 2 + strlen(subscriptions.topic(i)) + 1;
+      if (count > 0 && packet + len > Config::max_subscribe_packet) {
+        break;
+      }
+      topics[count] = subscriptions.topic(i);
+      qos[count] = subscriptions.qos(i);
+      count++;
+      packet += len;
+    }
+    if (count == 0) {
+      return true;
+    }
+    size_t sent = mqttClient->subscribe(topics, qos, count, ids);
+    for (size_t i = 0, marked = 0; marked < sent; i++) {
+      if (subscriptions.state(i) == subscription_table_t::PENDING) {
+        subscriptions.setSent(i, ids[marked]);
+        marked++;
+      }
+    }
+    bytes += packet;
+    if (sent < count) {
+      return false;
+    }
+  }
+  return true;
+}
+
+// sent entries wait for their SUBACK without holding up the publishes
+template <typename Config>
+bool MqttNetT<Config>::subscriptionsPending() {
+  return subscriptions.any(subscription_table_t::PENDING) || subscriptions.any(subscription_table_t::UNSUBSCRIBE);
+}
+
+template <typename Config>
+const MqttNetHistogram &MqttNetT<Config>::dequeueHistogram() {
+  return histogram(&MqttNetMetrics::dequeue_us, stats_enabled());
+}
+
+template <typename Config>
+bool MqttNetT<Config>::fullTopic(char *full_topic, const char *topic) {
+  return (size_t)snprintf(full_topic, Config::max_topic, "%s/%s", mqtt_prefix, topic) < Config::max_topic;
+}
+
+// topics below net/ that MqttNet subscribes to
+template <typename Config>
+bool MqttNetT<Config>::isInternalTopic(const char *topic) {
+  if (strcmp(topic, "net/ping") == 0 || strcmp(topic, "net/restart") == 0) {
+    return true;
+  }
+  if (Config::sync && strncmp(topic, "net/sync/", 9) == 0) {
+    const char *action = topic + 9;
+    return strcmp(action, "reset") == 0 || strcmp(action, "name") == 0 || strcmp(action, "md5") == 0 ||
+        strcmp(action, "size") == 0 || strcmp(action, "data") == 0 || strcmp(action, "chunk") == 0;
+  }
+  if (Config::fetch && strncmp(topic, "net/fetch/", 10) == 0) {
+    const char *action = topic + 10;
+    return strcmp(action, "start") == 0 || strcmp(action, "credit") == 0 || strcmp(action, "abort") == 0;
+  }
+  return false;
+}
+
+template <typename Config>
+const MqttNetHistogram &MqttNetT<Config>::inboundHistogram() {
+  return histogram(&MqttNetMetrics::inbound_us, stats_enabled());
+}
+
+template <typename Config>
+bool MqttNetT<Config>::isConnected() {
+  return mqttClient->connected();
+}
+
+template <typename Config>
+void MqttNetT<Config>::onMqttConnect(bool sessionPresent) {
+  updateMetrics([](MqttNetMetrics &m) { m.mqtt_reconnections++; });
+  Serial.println("MqttNet: mqtt connected");
+  if (!sessionPresent) {
+    subscriptions.markAllPending();
+  } else {
+    subscriptions.resend(subscription_table_t::SENT);
+  }
+  publish("net/connected", 0, 1, "1");
+  subscribe("net/ping", 0);
+  if (Config::sync && Config::collapse_internal) {
+    // also matches the small net/sync/state and net/sync/entry replies,
+    // which handleMessage() drops
+    subscribe("net/sync/+", 0);
+  } else if (Config::sync) {
+    subscribe("net/sync/reset", 0);
+    subscribe("net/sync/name", 0);
+    subscribe("net/sync/md5", 0);
+    subscribe("net/sync/size", 0);
+    subscribe("net/sync/data", 0);
+    subscribe("net/sync/chunk", 0);
+  }
+  // net/fetch/+ would also return every net/fetch/data chunk to the device
+  if (Config::fetch) {
+    subscribe("net/fetch/start", 0);
+    subscribe("net/fetch/credit", 0);
+    subscribe("net/fetch/abort", 0);
+  }
+  subscribe("net/restart", 0);
+  if (Config::metadata) {
+    publishMetadata();
+  }
+  if (Config::stats) {
+    publishStats();
+  }
+  if (connect_callback) {
+    connect_callback(sessionPresent);
+  }
+}
+
+template <typename Config>
+void MqttNetT<Config>::onMqttDisconnect(MqttNetDisconnectReason reason) {
+  Serial.print("MqttNet: mqtt disconnected, reason=");
+  Serial.println((int)reason, DEC);
+  abortFetch(fetch_enabled());
+  if (disconnect_callback) {
+    disconnect_callback(reason);
+  }
+  mqttReconnectTimer.once_ms_scheduled(1000, call<&MqttNetT::reconnectToMqtt>, this);
+}
+
+// Runs in the receive callback of the client: only copies the message into
+// the inbound queue, inboundHandler() handles it from the main loop.
+template <typename Config>
+void MqttNetT<Config>::onMqttMessage(char* topic, char* payload, MqttNetMessageProperties properties, size_t len, size_t index, size_t total) {
+  size_t topic_len = strlen(topic) + 1;
+  bool was_empty = inqueue.empty();
+  if (index == 0) {
+    _inbound_dropping = false;
+  }
+  size_t done = 0;
+  do {
+    size_t chunk = len - done < Config::inbound_chunk ? len - done : Config::inbound_chunk;
+    uint8_t *record = _inbound_dropping ? nullptr : inqueue.reserve(sizeof(InboundHeader) + topic_len + chunk);
+    if (!record) {
+      updateMetrics([](MqttNetMetrics &m) { m.inbound_dropped++; });
+      // a message with a hole is worse than no message
+      _inbound_dropping = index + len < total;
+      if (isSyncTopic(topic) && !_inbound_lost_sync) {
+        _inbound_lost_at = _inbound_committed;
+        _inbound_lost_sync = true;
+      }
+      break;
+    }
+    InboundHeader header;
+    header.index = index + done;
+    header.total = total;
+    header.length = chunk;
+    header.properties = properties;
+    memcpy(record, &header, sizeof(header));
+    memcpy(record + sizeof(header), topic, topic_len);
+    memcpy(record + sizeof(header) + topic_len, payload + done, chunk);
+    inqueue.commit();
+    _inbound_committed++;
+    done += chunk;
+  } while (done < len);
+
+  size_t used = inqueue.bytes();
+  updateMetrics([used](MqttNetMetrics &m) {
+    if (used > m.inbound_max_bytes) {
+      m.inbound_max_bytes = used;
+    }
+  });
+  if (Config::inbound_pool - used < inbound_pause && !_inbound_paused) {
+    _inbound_paused = true;
+    updateMetrics([](MqttNetMetrics &m) { m.inbound_pauses++; });
+    mqttClient->pauseReceive(true);
+  }
+  if (was_empty) {
+    inboundTimer.once_ms_scheduled(0, call<&MqttNetT::inboundHandler>, this);
+  }
+}
+
+template <typename Config>
+void MqttNetT<Config>::inboundHandler() {
+  unsigned long start = micros();
+  size_t bytes = 0;
+  size_t size;
+  uint8_t *record;
+  for (;;) {
+    if (_inbound_lost_sync && _inbound_handled == _inbound_lost_at) {
+      abortSync(sync_enabled());
+      publish("net/sync/state", 0, 0, "error: message dropped, inbound queue full");
+      _inbound_lost_sync = false;
+    }
+    if ((record = inqueue.front(&size)) == nullptr) {
+      break;
+    }
+    if (!dequeueBudgetLeft(start, bytes)) {
+      inboundTimer.once_ms_scheduled(0, call<&MqttNetT::inboundHandler>, this);
+      return;
+    }
+    InboundHeader header;
+    memcpy(&header, record, sizeof(header));
+    char *topic = (char *)record + sizeof(header);
+    char *payload = topic + strlen(topic) + 1;
+    unsigned long handler_start = micros();
+    handleMessage(topic, payload, header.properties, header.length, header.index, header.total);
+    updateMetrics([handler_start](MqttNetMetrics &m) { m.inbound_us.add(micros() - handler_start); });
+    bytes += size;
+    inqueue.pop();
+    _inbound_handled++;
+    if (_inbound_paused && (inqueue.empty() || Config::inbound_pool - inqueue.bytes() >= inbound_resume)) {
+      _inbound_paused = false;
+      mqttClient->pauseReceive(false);
+    }
+  }
+  if (!pubqueue.empty()) {
+    // send the replies without waiting for the next dequeue tick
+    dequeueResumeTimer.once_ms_scheduled(0, call<&MqttNetT::dequeueHandler>, this);
+  }
+}
+
+template <typename Config>
+bool MqttNetT<Config>::isSyncTopic(const char *topic) {
+  size_t prefix_len = strlen(mqtt_prefix);
+  return Config::sync && strncmp(topic, mqtt_prefix, prefix_len) == 0 &&
+      strncmp(topic + prefix_len, "/net/sync/", 10) == 0;
+}
+
+template <typename Config>
+void MqttNetT<Config>::handleMessage(char* topic, char* payload, MqttNetMessageProperties properties, size_t len, size_t index, size_t total) {
+  size_t prefix_len = strlen(mqtt_prefix) + 1;
+  const char *sub_topic = strlen(topic) > prefix_len ? topic + prefix_len : "";
+
+  if (strcmp(sub_topic, "net/junk") == 0) {
+    Serial.print(".");
+    return;
+  }
+
+  if (Config::collapse_internal && strncmp(sub_topic, "net/", 4) == 0 && !isInternalTopic(sub_topic)) {
+    return;
+  }
+
+  Serial.print(millis(), DEC);
+  Serial.print(" message: topic=");
+  Serial.print(sub_topic);
+  Serial.print(" index=");
+  Serial.print(index, DEC);
+  Serial.print(" len=");
+  Serial.print(len, DEC);
+  Serial.print(" total=");
+  Serial.println(total, DEC);
+
+  if (strncmp(sub_topic, "net/sync/", 9) == 0) {
+    if (allowRemoteSync) {
+      onMqttFileMessage(sub_topic + 9, payload, properties, len, index, total, sync_enabled());
+      return;
+    } else {
+      publish("net/sync/state", 0, 0, "disabled");
+      return;
+    }
+  }
+
+  if (strncmp(sub_topic, "net/fetch/", 10) == 0) {
+    if (allowRemoteFetch) {
+      onMqttFetchMessage(sub_topic + 10, payload, len, index, total, fetch_enabled());
+    } else {
+      publish("net/fetch/state", 0, 0, "disabled");
+    }
+    return;
+  }
+
+  if (message_callback) {
+    message_callback(sub_topic, payload, properties, len, index, total);
+  }
+
+  if (index == 0 && len == total && len < 256 && !properties.dup) {
+    char data[len+1];
+    memcpy(data, payload, len);
+    data[len] = 0;
+    onMqttString(sub_topic, data, properties.retain);
+  }
+}
+
+template <typename Config>
+void MqttNetT<Config>::onMqttFileMessage(const char *, char*, MqttNetMessageProperties, size_t, size_t, size_t, std::false_type) {
+  publish("net/sync/state", 0, 0, "disabled");
+}
+
+template <typename Config>
+void MqttNetT<Config>::onMqttFileMessage(const char *action, char* payload, MqttNetMessageProperties properties, size_t len, size_t index, size_t total, std::true_type) {
+  FileWriter &fileWriter = this->fileWriter.value;
+
+  if (properties.retain || properties.dup) {
+    return;
+  }
+
+  if (strcmp(action, "reset") == 0) {
+    abortSync(sync_enabled());
+    publish("net/sync/state", 0, 0, "ready");
+    return;
+  }
+
+  if (strcmp(action, "data") == 0) {
+    if (newFileName[0] && newFileMD5[0] && newFileSize >= 0) {
+      if (strcmp(newFileName, "*firmware*") == 0) {
+        addFirmware(payload, len, firmware_enabled());
+      } else if (strcmp(newFileName, "*bundle*") == 0) {
+        addBundle(payload, len);
+      } else {
+        addFile(payload, len, -1);
+      }
+    } else {
+      publish("net/sync/state", 0, 0, "error: not ready for data");
+    }
+    return;
+  }
+
+  if (strcmp(action, "chunk") == 0) {
+    onSyncChunk(payload, len, index, total);
+    return;
+  }
+
+  char value[MQTTNET_FILENAME_MAX > 33 ? MQTTNET_FILENAME_MAX : 33] = "";
+  if (index == 0 && len == total) {
+    if (len >= sizeof(value)) {
+      publish("net/sync/state", 0, 0, "error: value too long");
+      return;
+    }
+    memcpy(value, payload, len);
+    value[len] = 0;
+  }
+
+  if (strcmp(action, "name") == 0) {
+    strncpy(newFileName, value, sizeof(newFileName));
+    newFileName[sizeof(newFileName) - 1] = 0;
+  } else if (strcmp(action, "md5") == 0) {
+    strncpy(newFileMD5, value, sizeof(newFileMD5));
+    newFileMD5[sizeof(newFileMD5) - 1] = 0;
+  } else if (strcmp(action, "size") == 0) {
+    newFileSize = atoi(value);
+  }
+
+  if (newFileName[0] && newFileMD5[0] && newFileSize >= 0) {
+    abortFirmware(firmware_enabled());
+    fileWriter.Abort();
+    bundleWriter.value.Abort();
+    syncChunks.value.reset();
+    if (strcmp(newFileName, "*firmware*") == 0) {
+      beginFirmware(firmware_enabled());
+      return;
+    } else if (strcmp(newFileName, "*bundle*") == 0) {
+      beginBundle();
+      return;
+    } else {
+      if (fileWriter.Begin(newFileName, newFileMD5, newFileSize)) {
+        if (fileWriter.UpToDate()) {
+          clearNewFile();
+          publish("net/sync/state", 0, 0, "ok");
+          return;
+        } else {
+          if (fileWriter.Open()) {
+            publishf("net/sync/state", 0, 0, "%d", fileWriter.GetPosition());
+            return;
+          } else {
+            publish("net/sync/state", 0, 0, "error: open failed");
+            return;
+          }
+        }
+      } else {
+        publish("net/sync/state", 0, 0, "error: begin failed");
+        return;
+      }
+    }
+  } else {
+    publish("net/sync/state", 0, 0, "waiting");
+  }
+}
+
+template <typename Config>
+void MqttNetT<Config>::onMqttFetchMessage(const char *, char*, size_t, size_t, size_t, std::false_type) {
+  publish("net/fetch/state", 0, 0, "disabled");
+}
+
+// net/fetch/start "<name>" or "<name>@<offset>" opens a file, every chunk
+// sent to net/fetch/data (a 4 byte offset and up to fetch_chunk bytes) uses
+// up one credit granted by net/fetch/credit, and net/fetch/md5 ends the
+// transfer.
+template <typename Config>
+void MqttNetT<Config>::onMqttFetchMessage(const char *action, char* payload, size_t len, size_t index, size_t total, std::true_type) {
+  FileReader &fileReader = this->fileReader.value;
+
+  char value[MQTTNET_FILENAME_MAX + 12] = "";
+  if (index == 0 && len == total) {
+    if (len >= sizeof(value)) {
+      publish("net/fetch/state", 0, 0, "error: value too long");
+      return;
+    }
+    memcpy(value, payload, len);
+    value[len] = 0;
+  }
+
+  if (strcmp(action, "start") == 0) {
+    abortFetch(fetch_enabled());
+    size_t offset = 0;
+    char *at = strrchr(value, '@');
+    if (at) {
+      *at = 0;
+      offset = atol(at + 1);
+    }
+    if (fileReader.Begin(value, offset)) {
+      publishf("net/fetch/state", 0, 0, "%lu", (unsigned long)fileReader.GetSize());
+    } else {
+      publish("net/fetch/state", 0, 0, "error: begin failed");
+    }
+  } else if (strcmp(action, "credit") == 0) {
+    char *end;
+    unsigned long credit = strtoul(value, &end, 10);
+    if (value[0] < '0' || value[0] > '9' || *end) {
+      publish("net/fetch/state", 0, 0, "error: bad credit");
+      return;
+    }
+    if (fileReader.Running()) {
+      // more than fetch_window is ignored
+      fetchCredit = credit < Config::fetch_window - fetchCredit ? fetchCredit + credit : Config::fetch_window;
+      fetchPump(fetch_enabled());
+    }
+  } else if (strcmp(action, "abort") == 0) {
+    abortFetch(fetch_enabled());
+    publish("net/fetch/state", 0, 0, "ready");
+  }
+}
+
+template <typename Config>
+void MqttNetT<Config>::abortFetch(std::true_type) {
+  fileReader.value.Abort();
+  fetchCredit = 0;
+}
+
+// Queues as many chunks as there are credits and room in pubqueue, so the
+// window never exceeds what pubqueue can hold.
+template <typename Config>
+void MqttNetT<Config>::fetchPump(std::true_type) {
+  FileReader &fileReader = this->fileReader.value;
+  if (!fileReader.Running() || !mqttClient->connected()) {
+    return;
+  }
+  size_t topic_len = strlen(mqtt_prefix) + 1 + strlen("net/fetch/data");
+  uint8_t chunk[4 + fetch_chunk];
+  while (fetchCredit > 0 && !fileReader.Done()) {
+    size_t len = fileReader.GetSize() - fileReader.GetPosition();
+    if (len > fetch_chunk) {
+      len = fetch_chunk;
+    }
+    if (!pubqueue.fits(topic_len, 4 + len)) {
+      return;
+    }
+    uint32_t offset = fileReader.GetPosition();
+    chunk[0] = offset >> 24;
+    chunk[1] = offset >> 16;
+    chunk[2] = offset >> 8;
+    chunk[3] = offset;
+    if (fileReader.Read(chunk + 4, len) != len) {
+      abortFetch(fetch_enabled());
+      publish("net/fetch/state", 0, 0, "error: read failed");
+      return;
+    }
+    publish("net/fetch/data", 0, 0, (const char *)chunk, 4 + len);
+    fetchCredit--;
+  }
+  if (fileReader.Done() && pubqueue.fits(topic_len - 1, 32)) {
+    publish("net/fetch/md5", 0, 0, fileReader.GetMD5());
+    abortFetch(fetch_enabled());
+  }
+}
+
+// writes data at pos, or after the data so far if pos is negative
+template <typename Config>
+bool MqttNetT<Config>::addFile(char *payload, size_t len, long pos) {
+  FileWriter &fileWriter = this->fileWriter.value;
+  bool added = pos < 0 ? fileWriter.Add((uint8_t*)payload, len) : fileWriter.Add((uint8_t*)payload, len, pos);
+  if (added) {
+    // chunks may arrive in any order, so for them the count of bytes
+    // received is no offset to continue from
+    publishf("net/sync/state", 0, 0, pos < 0 ? "%d" : "received %d", fileWriter.GetPosition());
+    if (fileWriter.GetPosition() >= newFileSize) {
+      if (fileWriter.Commit()) {
+        publish("net/sync/state", 0, 0, "ok");
+        if (file_callback) {
+          file_callback(newFileName);
+        }
+      } else {
+        publish("net/sync/state", 0, 0, "error: commit failed");
+      }
+      clearNewFile();
+    }
+    return true;
+  }
+  publish("net/sync/state", 0, 0, "error: add failed");
+  return false;
+}
+
+// net/sync/chunk is the checked alternative to net/sync/data: a 4 byte
+// offset, the CRC32 of offset and data, and the data. Chunks failing the
+// check are not written, and the range to send again is published as
+// "retry <offset> <length>" on net/sync/state. Files accept chunks in any
+// order, firmware and bundles only the next one.
+template <typename Config>
+void MqttNetT<Config>::onSyncChunk(char *payload, size_t len, size_t index, size_t total) {
+  MqttNetChunkReceiver<Config::sync_chunk> &chunks = this->syncChunks.value;
+  if (!(newFileName[0] && newFileMD5[0] && newFileSize >= 0)) {
+    if (index + len == total) {
+      publish("net/sync/state", 0, 0, "error: not ready for data");
+    }
+    return;
+  }
+  uint32_t retry_offset;
+  uint32_t retry_length;
+  switch (chunks.collect((uint8_t*)payload, len, index, total)) {
+    case MQTTNET_CHUNK_PARTIAL:
+      return;
+    case MQTTNET_CHUNK_MALFORMED:
+      if (index + len >= total) {
+        publishf("net/sync/state", 0, 0, "error: bad chunk, max %lu data bytes", (unsigned long)Config::sync_chunk);
+      }
+      return;
+    case MQTTNET_CHUNK_BAD_CRC:
+      updateMetrics([](MqttNetMetrics &m) { m.sync_bad_chunks++; });
+      publishRetry(chunks.offset(), chunks.length());
+      return;
+    case MQTTNET_CHUNK_NO_HEADER:
+      updateMetrics([](MqttNetMetrics &m) { m.sync_bad_chunks++; });
+      chunks.expected(&retry_offset, &retry_length);
+      publishRetry(retry_offset, retry_length);
+      return;
+    case MQTTNET_CHUNK_COMPLETE:
+      break;
+  }
+  if (!chunks.within(newFileSize)) {
+    publish("net/sync/state", 0, 0, "error: chunk beyond end");
+    return;
+  }
+  bool firmware = strcmp(newFileName, "*firmware*") == 0;
+  bool bundle = strcmp(newFileName, "*bundle*") == 0;
+  switch (chunks.place(!firmware && !bundle, &retry_offset, &retry_length)) {
+    case MQTTNET_CHUNK_DUPLICATE:
+      if (chunks.missing(&retry_offset, &retry_length)) {
+        publishRetry(retry_offset, retry_length);
+      }
+      return;
+    case MQTTNET_CHUNK_REJECT:
+      publishRetry(retry_offset, retry_length);
+      return;
+    case MQTTNET_CHUNK_GAP:
+      publishRetry(retry_offset, retry_length);
+      break;
+    case MQTTNET_CHUNK_ACCEPT:
+      break;
+  }
+  // the chunk only counts as received once it is written, so that a
+  // failed write can be retried
+  bool added;
+  if (firmware) {
+    added = addFirmware((char*)chunks.data(), chunks.length(), firmware_enabled());
+  } else if (bundle) {
+    added = addBundle((char*)chunks.data(), chunks.length());
+  } else {
+    added = addFile((char*)chunks.data(), chunks.length(), chunks.offset());
+  }
+  if (added) {
+    chunks.commit();
+  }
+}
+
+template <typename Config>
+void MqttNetT<Config>::publishRetry(uint32_t offset, uint32_t length) {
+  publishf("net/sync/state", 0, 0, "retry %lu %lu", (unsigned long)offset, (unsigned long)length);
+}
+
+// A "*bundle*" sync carries several files in one stream, see BundleWriter.
+// Every entry is reported on net/sync/entry as "<name>: staged",
+// "<name>: unchanged" or "<name>: error: ...", the bundle itself on
+// net/sync/state.
+template <typename Config>
+void MqttNetT<Config>::beginBundle() {
+  if (bundleWriter.value.Begin(newFileMD5, newFileSize)) {
+    publishf("net/sync/state", 0, 0, "%d", bundleWriter.value.GetPosition());
+  } else {
+    clearNewFile();
+    publishf("net/sync/state", 0, 0, "error: begin - %s", bundleWriter.value.GetError());
+  }
+}
+
+template <typename Config>
+bool MqttNetT<Config>::addBundle(char *payload, size_t len) {
+  BundleWriter &bundleWriter = this->bundleWriter.value;
+  if (bundleWriter.Add((uint8_t*)payload, len)) {
+    publishf("net/sync/state", 0, 0, "%d", bundleWriter.GetPosition());
+    if (bundleWriter.GetPosition() >= newFileSize) {
+      if (bundleWriter.Commit()) {
+        publish("net/sync/state", 0, 0, "ok");
+      } else {
+        publishf("net/sync/state", 0, 0, "error: commit - %s", bundleWriter.GetError());
+      }
+      clearNewFile();
+    }
+    return true;
+  }
+  publishf("net/sync/state", 0, 0, "error: add - %s", bundleWriter.GetError());
+  clearNewFile();
+  return false;
+}
+
+// finishes a bundle commit interrupted by a reset, committed entries are
+// passed to file_callback
+template <typename Config>
+void MqttNetT<Config>::recoverBundle(std::true_type) {
+  bundleWriter.value.onEntry([this](const char *name, const char *state) {
+    if (strcmp(state, "committed") == 0) {
+      if (file_callback) {
+        file_callback(name);
+      }
+    } else {
+      publishf("net/sync/entry", 0, 0, "%s: %s", name, state);
+    }
+  });
+  bundleWriter.value.Recover();
+}
+
+template <typename Config>
+void MqttNetT<Config>::abortSync(std::true_type) {
+  clearNewFile();
+  abortFirmware(firmware_enabled());
+  fileWriter.value.Abort();
+  bundleWriter.value.Abort();
+  syncChunks.value.reset();
+}
+
+template <typename Config>
+void MqttNetT<Config>::abortFirmware(std::true_type) {
+  firmwareWriter.value.Abort();
+}
+
+template <typename Config>
+bool MqttNetT<Config>::addFirmware(char *payload, size_t len, std::true_type) {
+  FirmwareWriter &firmwareWriter = this->firmwareWriter.value;
+  if (firmwareWriter.Add((uint8_t*)payload, len)) {
+    publishf("net/sync/state", 0, 0, "%d", firmwareWriter.GetPosition());
+    if (firmwareWriter.GetPosition() >= newFileSize) {
+      if (firmwareWriter.Commit()) {
+        publish("net/sync/state", 0, 0, "ok");
+        _restartRequiredForFirmware = true;
+      } else {
+        publishf("net/sync/state", 0, 0, "error: commit - %d", firmwareWriter.GetUpdaterError());
+      }
+      clearNewFile();
+    }
+    return true;
+  }
+  publishf("net/sync/state", 0, 0, "error: add - %d", firmwareWriter.GetUpdaterError());
+  return false;
+}
+
+template <typename Config>
+bool MqttNetT<Config>::addFirmware(char *, size_t, std::false_type) {
+  publish("net/sync/state", 0, 0, "error: firmware not supported");
+  return false;
+}
+
+template <typename Config>
+void MqttNetT<Config>::beginFirmware(std::true_type) {
+  FirmwareWriter &firmwareWriter = this->firmwareWriter.value;
+  if (firmwareWriter.Begin(newFileMD5, newFileSize)) {
+    if (firmwareWriter.UpToDate()) {
+      clearNewFile();
+      publish("net/sync/state", 0, 0, "ok");
+    } else {
+      publishf("net/sync/state", 0, 0, "%d", firmwareWriter.GetPosition());
+    }
+  } else {
+    publishf("net/sync/state", 0, 0, "error: begin - %d", firmwareWriter.GetUpdaterError());
+  }
+}
+
+template <typename Config>
+void MqttNetT<Config>::beginFirmware(std::false_type) {
+  clearNewFile();
+  publish("net/sync/state", 0, 0, "error: firmware not supported");
+}
+
+template <typename Config>
+void MqttNetT<Config>::onMqttString(const char *topic, const char *payload, bool retain) {
+  if (strcmp(topic, "net/restart") == 0) {
+    _restartRequiredForNetwork = true;
+    return;
+  }
+  if (strcmp(topic, "net/ping") == 0) {
+    publish("net/pong", 0, 0, payload);
+  }
+  if (string_callback) {
+    string_callback(topic, payload, retain);
+  }
+}
+
+template <typename Config>
+void MqttNetT<Config>::onWifiConnect() {
+  updateMetrics([](MqttNetMetrics &m) { m.wifi_reconnections++; });
+  Serial.println("MqttNet: wifi connected");
+}
+
+template <typename Config>
+void MqttNetT<Config>::onWifiDisconnect() {
+  Serial.println("MqttNet: wifi disconnected");
+}
+
+template <typename Config>
+uint16_t MqttNetT<Config>::publish(const char *topic, uint8_t qos, bool retain, const char *payload, size_t length) {
+  if (!mqttClient->connected()) {
+    Serial.println("not connected, discarding message");
+    return 0;
+  }
+
+  size_t prefix_len = strlen(mqtt_prefix);
+  size_t topic_len = strlen(topic);
+  if (prefix_len + 1 + topic_len >= Config::max_topic || length > Config::max_payload) {
+    Serial.println("topic or payload too long, discarding message");
+    return 0;
+  }
+
+  char *full_topic;
+  uint8_t *data;
+  if (!pubqueue.push(prefix_len + 1 + topic_len, length, qos, retain, &full_topic, &data)) {
+    Serial.println("publish queue full, discarding message");
+    return 0;
+  }
+  memcpy(full_topic, mqtt_prefix, prefix_len);
+  full_topic[prefix_len] = '/';
+  memcpy(full_topic + prefix_len + 1, topic, topic_len);
+  memcpy(data, payload, length);
+  return 1;
+}
+
+template <typename Config>
+uint16_t MqttNetT<Config>::publish(const char *topic, uint8_t qos, bool retain, const char *payload) {
+  return publish(topic, qos, retain, payload, strlen(payload));
+}
+
+template <typename Config>
+uint16_t MqttNetT<Config>::publish(String topic, uint8_t qos, bool retain, String payload) {
+  return publish(topic.c_str(), qos, retain, payload.c_str(), payload.length());
+}
+
+// publishes a status formatted into a stack buffer, so that status
+// messages cost no heap allocations
+template <typename Config>
+uint16_t MqttNetT<Config>::publishf(const char *topic, uint8_t qos, bool retain, const char *format, ...) {
+  char payload[MQTTNET_FILENAME_MAX + 48];
+  va_list args;
+  va_start(args, format);
+  int len = vsnprintf(payload, sizeof(payload), format, args);
+  va_end(args);
+  if (len < 0) {
+    return 0;
+  }
+  return publish(topic, qos, retain, payload, (size_t)len < sizeof(payload) ? len : sizeof(payload) - 1);
+}
+
+template <typename Config>
+void MqttNetT<Config>::publishMetadata() {
+  if (mqttClient->connected()) {
+    publish("net/address", 0, 1, network.localAddress());
+    platform.publishMetadata([this](const char *topic, String value) { publish(topic, 0, 1, value); });
+  }
+}
+
+template <typename Config>
+void MqttNetT<Config>::publishStats() {
+  if (mqttClient->connected()) {
+    publishf("net/millis", 0, 1, "%lu", (unsigned long)millis());
+    platform.publishStats([this](const char *topic, String value) { publish(topic, 0, 1, value); });
+    publishMetrics(stats_enabled());
+    publishBatchStats(batch_enabled());
+  }
+}
+
+template <typename Config>
+void MqttNetT<Config>::publishMetrics(std::true_type) {
+  MqttNetMetrics &metrics = this->metrics.value;
+  char histogram[MqttNetHistogram::format_size];
+  publishf("net/wifi_reconnections", 0, 1, "%d", metrics.wifi_reconnections);
+  publishf("net/mqtt_reconnections", 0, 1, "%d", metrics.mqtt_reconnections);
+  publish("net/dequeue_us", 0, 1, histogram, metrics.dequeue_us.format(histogram, sizeof(histogram)));
+  publishf("net/dequeue_max_us", 0, 1, "%lu", (unsigned long)metrics.dequeue_us.max());
+  publish("net/inbound_us", 0, 1, histogram, metrics.inbound_us.format(histogram, sizeof(histogram)));
+  publishf("net/inbound_max_us", 0, 1, "%lu", (unsigned long)metrics.inbound_us.max());
+  publishf("net/inbound_max_bytes", 0, 1, "%lu", (unsigned long)metrics.inbound_max_bytes);
+  publishf("net/inbound_dropped", 0, 1, "%lu", metrics.inbound_dropped);
+  publishf("net/inbound_pauses", 0, 1, "%lu", metrics.inbound_pauses);
+  if (Config::sync) {
+    publishf("net/sync_bad_chunks", 0, 1, "%lu", metrics.sync_bad_chunks);
+  }
+}
+
+// without stats the histograms stay empty
+template <typename Config>
+const MqttNetHistogram &MqttNetT<Config>::histogram(MqttNetHistogram MqttNetMetrics::*, std::false_type) {
+  static const MqttNetHistogram empty;
+  return empty;
+}
+
+template <typename Config>
+void MqttNetT<Config>::publishBatchStats(std::true_type) {
+  MqttNetBatch<Config::batch_size, Config::max_topic> &batch = this->batch.value;
+  char flushes[batch.flushes_size];
+  publish("net/batch_flushes", 0, 1, flushes, batch.flushes(flushes, sizeof(flushes)));
+  publishf("net/batch_readings", 0, 1, "%lu", (unsigned long)batch.totalReadings());
+  publishf("net/batch_bytes", 0, 1, "%lu", (unsigned long)batch.totalBytes());
+}
+
+template <typename Config>
+bool MqttNetT<Config>::restartRequired() {
+  return _restartRequiredForNetwork || _restartRequiredForFirmware || _restartRequiredForWatchdog;
+}
+
+template <typename Config>
+bool MqttNetT<Config>::restartRequiredForFirmware() {
+  return _restartRequiredForFirmware;
+}
+
+template <typename Config>
+void MqttNetT<Config>::setClientId(const char *clientId) {
+  clientid = clientId;
+}
+
+template <typename Config>
+void MqttNetT<Config>::setConfig(const char *host, uint16_t port, bool tls, const char *username, const char *password, const char *prefix) {
+  mqtt_host = host;
+  mqtt_port = port;
+  mqtt_tls = tls;
+  mqtt_username = username;
+  mqtt_password = password;
+  mqtt_prefix = prefix;
+}
+
+template <typename Config>
+void MqttNetT<Config>::setWatchdog(long timeout) {
+  _watchdogRestartTimeout = timeout;
+  if (timeout <= 0) {
+    _restartRequiredForWatchdog = false;
+  }
+}
+
+template <typename Config>
+uint16_t MqttNetT<Config>::subscribe(const char *topic, uint8_t qos) {
+  char full_topic[Config::max_topic];
+  if (!fullTopic(full_topic, topic)) {
+    return 0;
+  }
+  if (!subscriptions.add(full_topic, qos)) {
+    Serial.println("subscription table full, discarding subscription");
+    return 0;
+  }
+  return 1;
+}
+
+template <typename Config>
+uint16_t MqttNetT<Config>::subscribe(String topic, uint8_t qos) {
+  return subscribe(topic.c_str(), qos);
+}
+
+template <typename Config>
+uint16_t MqttNetT<Config>::unsubscribe(const char *topic) {
+  char full_topic[Config::max_topic];
+  if (!fullTopic(full_topic, topic)) {
+    return 0;
+  }
+  int i = subscriptions.find(full_topic);
+  if (i < 0) {
+    return 0;
+  }
+  subscriptions.setState(i, subscription_table_t::UNSUBSCRIBE);
+  return 1;
+}
+
+// Runs in the receive callback of the client, like onMqttMessage(), but only
+// updates the state of table entries.
+template <typename Config>
+void MqttNetT<Config>::onMqttSubscribe(uint16_t packetId, const uint8_t *codes, size_t count) {
+  size_t failed = subscriptions.acknowledge(packetId, codes, count);
+  if (failed > 0) {
+    _subscribeFailedAt = millis();
+    Serial.print("MqttNet: subscriptions rejected by broker, count=");
+    Serial.println(failed, DEC);
+  }
+}
+
+template <typename Config>
+void MqttNetT<Config>::watchdogHandler() {
+  if (subscriptions.any(subscription_table_t::FAILED) && millis() - _subscribeFailedAt >= Config::subscribe_retry) {
+    subscriptions.resend(subscription_table_t::FAILED);
+  }
+  if (network.isConnected() && mqttClient->connected()) {
+    _watchdogLastOk = millis();
+  }
+  if (_watchdogRestartTimeout > 0) {
+    if ((long)(millis() - _watchdogLastOk) > _watchdogRestartTimeout) {
+      if (!_restartRequiredForWatchdog) {
+        Serial.println("MqttNet: network watchdog requesting restart");
+        _restartRequiredForWatchdog = true;
+      }
+    } else {
+      _restartRequiredForWatchdog = false;
+    }
+  }
+}
+
+#endif
@@ -0,0 +1,18 @@
+#ifndef MQTTNETMETRICS_HPP
+#define MQTTNETMETRICS_HPP
+
+#include "MqttNetHistogram.hpp"
+
+// Counters behind the net/* statistics, only compiled in with Config::stats.
+struct MqttNetMetrics {
+  int wifi_reconnections = -1;
+  int mqtt_reconnections = -1;
+  MqttNetHistogram dequeue_us;
+  MqttNetHistogram inbound_us;
+  size_t inbound_max_bytes = 0;
+  unsigned long inbound_dropped = 0;
+  unsigned long inbound_pauses = 0;
+  unsigned long sync_bad_chunks = 0;
+};
+
+#endif
@@ -0,0 +1,165 @@
+#ifndef MQTTNETPLATFORM_HPP
+#define MQTTNETPLATFORM_HPP
+
+#include <functional>
+#include <stdint.h>
+#include <stddef.h>
+
+#ifdef ARDUINO
+#include <Arduino.h>
+#include <AsyncMqttClient.h>
+
+typedef AsyncMqttClientMessageProperties MqttNetMessageProperties;
+typedef AsyncMqttClientDisconnectReason MqttNetDisconnectReason;
+
+#if defined(ARDUINO_ARCH_ESP8266)
+#define MQTTNET_FIRMWARE 1
+#endif
+
+#else
+#include "posix/MqttNetCompat.hpp"
+
+struct MqttNetMessageProperties {
+  uint8_t qos;
+  bool dup;
+  bool retain;
+};
+
+// Same values as AsyncMqttClientDisconnectReason, so that callbacks can be
+// shared between the ESP8266 and the POSIX builds.
+enum class MqttNetDisconnectReason : int8_t {
+  TCP_DISCONNECTED = 0,
+  MQTT_UNACCEPTABLE_PROTOCOL_VERSION = 1,
+  MQTT_IDENTIFIER_REJECTED = 2,
+  MQTT_SERVER_UNAVAILABLE = 3,
+  MQTT_MALFORMED_CREDENTIALS = 4,
+  MQTT_NOT_AUTHORIZED = 5,
+  ESP8266_NOT_ENOUGH_SPACE = 6,
+  TLS_BAD_FINGERPRINT = 7
+};
+#endif
+
+#ifndef MQTTNET_FIRMWARE
+#define MQTTNET_FIRMWARE 0
+#endif
+
+class MqttNetClient {
+ public:
+  typedef std::function<void(bool sessionPresent)> connect_handler_t;
+  typedef std::function<void(MqttNetDisconnectReason reason)> disconnect_handler_t;
+  typedef std::function<void(char* topic, char* payload, MqttNetMessageProperties properties, size_t len, size_t index, size_t total)> message_handler_t;
+  // one return code per topic filter of the SUBSCRIBE, 0x80 if rejected
+  typedef std::function<void(uint16_t packetId, const uint8_t *codes, size_t count)> subscribe_handler_t;
+
+  virtual ~MqttNetClient() {}
+  virtual void onConnect(connect_handler_t handler) = 0;
+  virtual void onDisconnect(disconnect_handler_t handler) = 0;
+  virtual void onMessage(message_handler_t handler) = 0;
+  virtual void onSubscribe(subscribe_handler_t handler) = 0;
+  virtual void setClientId(const char *clientId) = 0;
+  virtual void setServer(const char *host, uint16_t port) = 0;
+  virtual void setSecure(bool secure) = 0;
+  virtual void setCredentials(const char *username, const char *password) = 0;
+  virtual void setWill(const char *topic, uint8_t qos, bool retain, const char *payload) = 0;
+  virtual void setCleanSession(bool cleanSession) = 0;
+  virtual void connect() = 0;
+  virtual void disconnect() = 0;
+  virtual bool connected() = 0;
+  virtual uint16_t subscribe(const char *topic, uint8_t qos) = 0;
+  // Sends up to count topic filters in as few SUBSCRIBE packets as the
+  // client supports and returns how many were sent, with the packet id that
+  // carried each filter in packetIds. Clients without multi-filter SUBSCRIBE
+  // fall back to one packet per filter.
+  virtual size_t subscribe(const char *const *topics, const uint8_t *qos, size_t count, uint16_t *packetIds) {
+    size_t sent = 0;
+    while (sent < count && (packetIds[sent] = subscribe(topics[sent], qos[sent])) != 0) {
+      sent++;
+    }
+    return sent;
+  }
+  // Stops reading from the network while the receiver cannot take more
+  // messages, so that TCP flow control holds back the broker. Clients that
+  // cannot pause keep delivering.
+  virtual void pauseReceive(bool) {}
+  virtual uint16_t unsubscribe(const char *topic) = 0;
+  virtual uint16_t publish(const char *topic, uint8_t qos, bool retain, const char *payload, size_t length) = 0;
+};
+
+// Mirrors the subset of the ESP8266 Ticker API that MqttNet uses. Only the
+// _scheduled variants are used, their callbacks always run in the main loop
+// context, where they may publish and do file I/O. Callbacks are a function
+// pointer and its argument, so that arming a timer never allocates.
+class MqttNetTimer {
+ public:
+  typedef void (*callback_t)(void *arg);
+
+  virtual ~MqttNetTimer() {}
+  virtual void attach_ms_scheduled(uint32_t milliseconds, callback_t callback, void *arg) = 0;
+  virtual void once_ms_scheduled(uint32_t milliseconds, callback_t callback, void *arg) = 0;
+  virtual void detach() = 0;
+};
+
+class MqttNetNetwork {
+ public:
+  typedef std::function<void()> event_handler_t;
+
+  virtual ~MqttNetNetwork() {}
+  virtual void onConnect(event_handler_t handler) = 0;
+  virtual void onDisconnect(event_handler_t handler) = 0;
+  virtual bool isConnected() = 0;
+  virtual String localAddress() = 0;
+};
+
+// maximum path length including the terminator; SPIFFS itself stops at 31
+// characters, LittleFS paths may be longer
+#ifndef MQTTNET_FILENAME_MAX
+#define MQTTNET_FILENAME_MAX 64
+#endif
+
+// Handle based file access, so that backends can keep a fixed number of
+// open files without allocating file objects. Paths may contain
+// directories on backends that support them.
+class MqttNetStorage {
+ public:
+  virtual ~MqttNetStorage() {}
+  virtual int open(const char *path, const char *mode) = 0;
+  virtual size_t read(int handle, uint8_t *data, size_t len) = 0;
+  virtual size_t write(int handle, const uint8_t *data, size_t len) = 0;
+  virtual bool seek(int handle, size_t pos) = 0;
+  virtual size_t size(int handle) = 0;
+  virtual void close(int handle) = 0;
+  virtual bool exists(const char *path) = 0;
+  virtual bool remove(const char *path) = 0;
+  virtual bool rename(const char *from, const char *to) = 0;
+  // creates path and its parents, false if directories are not supported
+  virtual bool mkdir(const char *) { return false; }
+  // whether rename() atomically replaces an existing target, otherwise the
+  // target has to be removed first
+  virtual bool renameReplaces() { return false; }
+};
+
+enum MqttNetTimerId {
+  MQTTNET_TIMER_RECONNECT,
+  MQTTNET_TIMER_DEQUEUE,
+  MQTTNET_TIMER_DEQUEUE_RESUME,
+  MQTTNET_TIMER_INBOUND,
+  MQTTNET_TIMER_BATCH,
+  MQTTNET_TIMER_STATS,
+  MQTTNET_TIMER_WATCHDOG,
+  MQTTNET_TIMER_COUNT
+};
+
+class MqttNetPlatform {
+ public:
+  typedef std::function<void(const char *topic, String value)> publish_t;
+
+  virtual ~MqttNetPlatform() {}
+  virtual MqttNetClient &client() = 0;
+  virtual MqttNetTimer &timer(MqttNetTimerId id) = 0;
+  virtual MqttNetNetwork &network() = 0;
+  virtual MqttNetStorage &storage() = 0;
+  virtual void publishMetadata(publish_t publish) = 0;
+  virtual void publishStats(publish_t publish) = 0;
+};
+
+#endif
@@ -0,0 +1,165 @@
+#ifndef MQTTNETQUEUE_HPP
+#define MQTTNETQUEUE_HPP
+
+#include "MqttNetPlatform.hpp"
+
+class MqttNetMessage {
+ public:
+  const char *topic;
+  const char *payload;
+  uint16_t length;
+  uint8_t qos;
+  bool retain;
+};
+
+// FIFO of variable sized messages in a static byte pool. At most Depth
+// messages totalling PoolSize bytes (including a 6 byte header and the
+// topic terminator per message) can be queued, and nothing is allocated.
+template <size_t PoolSize, size_t Depth>
+class MqttNetMessageQueue {
+ private:
+  static const size_t header_size = 6;
+  static const uint16_t wrap_marker = 0xffff;
+  uint8_t pool[PoolSize];
+  size_t head = 0;
+  size_t tail = 0;
+  size_t used = 0;
+  size_t count = 0;
+
+  static_assert(PoolSize > header_size, "message pool too small");
+  static_assert(PoolSize <= 0xffff, "message pool too large");
+
+  void skipWrap() {
+    if (count == 0) {
+      return;
+    }
+    if (PoolSize - head < header_size ||
+        (pool[head] == (wrap_marker >> 8) && pool[head + 1] == (wrap_marker & 0xff))) {
+      used -= PoolSize - head;
+      head = 0;
+    }
+  }
+
+  uint8_t *reserve(size_t len) {
+    if (count >= Depth || used + len > PoolSize) {
+      return nullptr;
+    }
+    if (count == 0) {
+      head = tail = used = 0;
+    }
+    if (tail >= head) {
+      if (PoolSize - tail >= len) {
+        return pool + tail;
+      }
+      if (len > head) {
+        return nullptr;
+      }
+      if (PoolSize - tail >= header_size) {
+        pool[tail] = wrap_marker >> 8;
+        pool[tail + 1] = wrap_marker & 0xff;
+      }
+      used += PoolSize - tail;
+      tail = 0;
+      return pool;
+    }
+    if (head - tail >= len) {
+      return pool + tail;
+    }
+    return nullptr;
+  }
+
+ public:
+  static size_t recordSize(size_t topicLength, size_t payloadLength) {
+    return header_size + topicLength + 1 + payloadLength;
+  }
+
+  // Whether push() would currently succeed for these lengths.
+  bool fits(size_t topicLength, size_t payloadLength) const {
+    size_t len = recordSize(topicLength, payloadLength);
+    if (count >= Depth || used + len > PoolSize) {
+      return false;
+    }
+    if (count == 0 || tail < head) {
+      return count == 0 || head - tail >= len;
+    }
+    return PoolSize - tail >= len || len <= head;
+  }
+
+  // Reserves a record for a topic of topicLength and a payload of
+  // payloadLength bytes and returns the topic and payload buffers to fill
+  // in. The record is queued with the given flags.
+  bool push(size_t topicLength, size_t payloadLength, uint8_t qos, bool retain, char **topic, uint8_t **payload) {
+    size_t len = recordSize(topicLength, payloadLength);
+    if (topicLength >= wrap_marker || payloadLength >= wrap_marker) {
+      return false;
+    }
+    uint8_t *record = reserve(len);
+    if (!record) {
+      return false;
+    }
+    record[0] = topicLength >> 8;
+    record[1] = topicLength & 0xff;
+    record[2] = payloadLength >> 8;
+    record[3] = payloadLength & 0xff;
+    record[4] = qos;
+    record[5] = retain;
+    *topic = (char *)record + header_size;
+    (*topic)[topicLength] = 0;
+    *payload = record + header_size + topicLength + 1;
+    tail = (record - pool) + len;
+    if (tail == PoolSize) {
+      tail = 0;
+    }
+    used += len;
+    count++;
+    return true;
+  }
+
+  bool front(MqttNetMessage &message) {
+    skipWrap();
+    if (count == 0) {
+      return false;
+    }
+    const uint8_t *record = pool + head;
+    size_t topicLength = (record[0] << 8) | record[1];
+    message.length = (record[2] << 8) | record[3];
+    message.qos = record[4];
+    message.retain = record[5];
+    message.topic = (const char *)record + header_size;
+    message.payload = (const char *)record + header_size + topicLength + 1;
+    return true;
+  }
+
+  void pop() {
+    skipWrap();
+    if (count == 0) {
+      return;
+    }
+    const uint8_t *record = pool + head;
+    size_t len = recordSize((record[0] << 8) | record[1], (record[2] << 8) | record[3]);
+    head += len;
+    if (head == PoolSize) {
+      head = 0;
+    }
+    used -= len;
+    count--;
+  }
+
+  void clear() {
+    head = tail = used = count = 0;
+  }
+
+  bool empty() const {
+    return count == 0;
+  }
+
+  size_t size() const {
+    return count;
+  }
+
+  size_t bytes() const {
+    return used;
+  }
+};
+
+#endif
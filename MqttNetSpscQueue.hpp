@@ -0,0 +1,123 @@
+#ifndef MQTTNETSPSCQUEUE_HPP
+#define MQTTNETSPSCQUEUE_HPP
+
+#include <atomic>
+
+#include "MqttNetPlatform.hpp"
+
+// Lock-free FIFO of variable sized records in a static byte pool, for one
+// producer (the network receive callback) and one consumer (the main loop).
+// The producer reserve()s a record, fills it and commit()s it; the consumer
+// reads front() and pop()s it. Each record has a 2 byte length header, and
+// one byte of the pool always stays free to tell a full pool from an empty
+// one.
+template <size_t PoolSize>
+class MqttNetSpscQueue {
+ private:
+  static const size_t header_size = 2;
+  static const uint16_t wrap_marker = 0xffff;
+  uint8_t pool[PoolSize];
+  // head is written by the consumer only, tail by the producer only
+  std::atomic<size_t> head;
+  std::atomic<size_t> tail;
+  size_t reserved = 0;
+  size_t reservedSize = 0;
+
+  static_assert(PoolSize > header_size + 1, "spsc pool too small");
+  static_assert(PoolSize < wrap_marker, "spsc pool too large");
+
+  static void writeLength(uint8_t *at, uint16_t length) {
+    at[0] = length >> 8;
+    at[1] = length & 0xff;
+  }
+
+  static uint16_t readLength(const uint8_t *at) {
+    return (at[0] << 8) | at[1];
+  }
+
+  // position of the next record at or after pos, following a wrap
+  size_t unwrap(size_t pos) const {
+    if (PoolSize - pos < header_size || readLength(pool + pos) == wrap_marker) {
+      return 0;
+    }
+    return pos;
+  }
+
+ public:
+  MqttNetSpscQueue() : head(0), tail(0) {}
+
+  // Largest record that can ever be reserved.
+  static size_t capacity() {
+    return PoolSize - header_size - 1;
+  }
+
+  // Producer: returns room for size bytes, or nullptr if the pool is too
+  // full. Nothing is visible to the consumer until commit().
+  uint8_t *reserve(size_t size) {
+    size_t need = header_size + size;
+    size_t t = tail.load(std::memory_order_relaxed);
+    size_t h = head.load(std::memory_order_acquire);
+    if (t >= h) {
+      size_t end = h == 0 ? PoolSize - 1 : PoolSize;
+      if (t + need <= end) {
+        reserved = t;
+      } else if (need < h) {
+        if (PoolSize - t >= header_size) {
+          writeLength(pool + t, wrap_marker);
+        }
+        reserved = 0;
+      } else {
+        return nullptr;
+      }
+    } else if (t + need < h) {
+      reserved = t;
+    } else {
+      return nullptr;
+    }
+    reservedSize = size;
+    writeLength(pool + reserved, size);
+    return pool + reserved + header_size;
+  }
+
+  // Producer: makes the reserved record visible to the consumer.
+  void commit() {
+    size_t t = reserved + header_size + reservedSize;
+    tail.store(t == PoolSize ? 0 : t, std::memory_order_release);
+  }
+
+  // Consumer: oldest record, or nullptr if the queue is empty.
+  uint8_t *front(size_t *size) {
+    size_t h = head.load(std::memory_order_relaxed);
+    if (h == tail.load(std::memory_order_acquire)) {
+      return nullptr;
+    }
+    h = unwrap(h);
+    *size = readLength(pool + h);
+    return pool + h + header_size;
+  }
+
+  // Consumer: releases the record returned by front().
+  void pop() {
+    size_t h = head.load(std::memory_order_relaxed);
+    if (h == tail.load(std::memory_order_acquire)) {
+      return;
+    }
+    h = unwrap(h);
+    h += header_size + readLength(pool + h);
+    head.store(h == PoolSize ? 0 : h, std::memory_order_release);
+  }
+
+  bool empty() const {
+    return head.load(std::memory_order_acquire) == tail.load(std::memory_order_acquire);
+  }
+
+  // Bytes in use, including headers and space skipped at a wrap. Exact from
+  // either side, as the other side can only make it move in one direction.
+  size_t bytes() const {
+    size_t h = head.load(std::memory_order_acquire);
+    size_t t = tail.load(std::memory_order_acquire);
+    return t >= h ? t - h : PoolSize - h + t;
+  }
+};
+
+#endif
@@ -0,0 +1,161 @@
+#ifndef MQTTNETSUBSCRIPTIONS_HPP
+#define MQTTNETSUBSCRIPTIONS_HPP
+
+#include "MqttNetPlatform.hpp"
+
+// Tracks the subscriptions of a MqttNet instance, so that they can be sent
+// in batches and replayed after a reconnect without a session. Up to
+// Capacity topic filters totalling PoolSize bytes (with terminators) are
+// stored; removing an entry compacts the pool. A sent entry remembers the
+// packet id of its SUBSCRIBE until the SUBACK makes it ACTIVE, or FAILED if
+// the broker rejected the filter.
+template <size_t PoolSize, size_t Capacity>
+class MqttNetSubscriptionTable {
+ public:
+  enum State {
+    ACTIVE,
+    PENDING,
+    UNSUBSCRIBE,
+    SENT,
+    FAILED
+  };
+
+ private:
+  struct Entry {
+    uint16_t offset;
+    uint16_t packetId;
+    uint8_t qos;
+    uint8_t state;
+  };
+  Entry entries[Capacity];
+  char pool[PoolSize];
+  size_t count = 0;
+  size_t used = 0;
+
+  static_assert(PoolSize <= 0xffff, "subscription pool too large");
+
+ public:
+  int find(const char *topic) const {
+    for (size_t i = 0; i < count; i++) {
+      if (strcmp(pool + entries[i].offset, topic) == 0) {
+        return i;
+      }
+    }
+    return -1;
+  }
+
+  // Adds topic (or updates its qos) and marks it for sending.
+  bool add(const char *topic, uint8_t qos) {
+    int i = find(topic);
+    if (i >= 0) {
+      if (entries[i].state != ACTIVE || entries[i].qos != qos) {
+        entries[i].qos = qos;
+        entries[i].state = PENDING;
+      }
+      return true;
+    }
+    size_t len = strlen(topic) + 1;
+    if (count >= Capacity || used + len > PoolSize) {
+      return false;
+    }
+    memcpy(pool + used, topic, len);
+    entries[count].offset = used;
+    entries[count].qos = qos;
+    entries[count].state = PENDING;
+    used += len;
+    count++;
+    return true;
+  }
+
+  void remove(size_t i) {
+    size_t offset = entries[i].offset;
+    size_t len = strlen(pool + offset) + 1;
+    memmove(pool + offset, pool + offset + len, used - offset - len);
+    used -= len;
+    for (size_t j = i; j + 1 < count; j++) {
+      entries[j] = entries[j + 1];
+    }
+    count--;
+    for (size_t j = 0; j < count; j++) {
+      if (entries[j].offset > offset) {
+        entries[j].offset -= len;
+      }
+    }
+  }
+
+  // Applies the return codes of the SUBACK for packetId, in the order the
+  // filters were sent, and returns how many were rejected.
+  size_t acknowledge(uint16_t packetId, const uint8_t *codes, size_t length) {
+    size_t next = 0, failed = 0;
+    for (size_t i = 0; i < count && next < length; i++) {
+      if (entries[i].state != SENT || entries[i].packetId != packetId) {
+        continue;
+      }
+      if (codes[next++] == 0x80) {
+        entries[i].state = FAILED;
+        failed++;
+      } else {
+        entries[i].state = ACTIVE;
+      }
+    }
+    return failed;
+  }
+
+  // Marks the entries in state from as PENDING, e.g. rejected ones to retry
+  // them, or sent ones whose SUBACK was lost with the connection.
+  void resend(State from) {
+    for (size_t i = 0; i < count; i++) {
+      if (entries[i].state == from) {
+        entries[i].state = PENDING;
+      }
+    }
+  }
+
+  bool any(State state) const {
+    for (size_t i = 0; i < count; i++) {
+      if (entries[i].state == state) {
+        return true;
+      }
+    }
+    return false;
+  }
+
+  // After a connect without a session the broker knows none of the topics.
+  void markAllPending() {
+    for (size_t i = 0; i < count; ) {
+      if (entries[i].state == UNSUBSCRIBE) {
+        remove(i);
+      } else {
+        entries[i].state = PENDING;
+        i++;
+      }
+    }
+  }
+
+  size_t size() const {
+    return count;
+  }
+
+  const char *topic(size_t i) const {
+    return pool + entries[i].offset;
+  }
+
+  uint8_t qos(size_t i) const {
+    return entries[i].qos;
+  }
+
+  State state(size_t i) const {
+    return (State)entries[i].state;
+  }
+
+  void setState(size_t i, State state) {
+    entries[i].state = state;
+  }
+
+  void setSent(size_t i, uint16_t packetId) {
+    entries[i].state = SENT;
+    entries[i].packetId = packetId;
+  }
+};
+
+#endif
@@ -0,0 +1,131 @@
+// Measures FileWriter write and commit throughput on SPIFFS and LittleFS,
+// the ESP8266 counterpart of posix/examples/storage_bench.cpp.
+//
+// Both file systems share the flash partition, so each one is formatted
+// before its run: do not flash this onto a device whose files you need.
+// For every file system the flash is first filled to 0, 25, 50 and 75% with
+// filler files, then a file of size_kb is written through FileWriter in
+// chunks of the given size and committed, five times per fill level.
+// Commit includes the MD5 verification pass over the temporary file and
+// the rename onto the target. Results are printed on Serial.
+
+#include <FS.h>
+#include <LittleFS.h>
+
+#include "FileWriter.hpp"
+#include "MqttNetEsp8266.hpp"
+
+static const size_t size_kb = 16;
+static const size_t chunk = 256;
+static const char *target = "/bench.bin";
+static const int rounds = 5;
+
+struct Result {
+  unsigned long write_us = 0;
+  unsigned long commit_us = 0;
+  bool ok = true;
+};
+
+// the data is generated again for every chunk instead of being kept in RAM
+static void generate(uint8_t *data, size_t len, size_t pos) {
+  for (size_t i = 0; i < len; i++) {
+    uint32_t x = (pos + i) * 2654435761u;
+    data[i] = x >> 24;
+  }
+}
+
+static String dataMD5() {
+  uint8_t data[chunk];
+  MD5Builder md5;
+  md5.begin();
+  for (size_t pos = 0; pos < size_kb * 1024; pos += chunk) {
+    generate(data, chunk, pos);
+    md5.add(data, chunk);
+  }
+  md5.calculate();
+  return md5.toString();
+}
+
+static int fill(MqttNetStorage &storage, size_t bytes) {
+  static uint8_t block[512];
+  char name[16];
+  int fillers = 0;
+  for (size_t written = 0; written < bytes; fillers++) {
+    snprintf(name, sizeof(name), "/fill%d", fillers);
+    int file = storage.open(name, "w");
+    if (file < 0) {
+      break;
+    }
+    size_t file_size = bytes - written < 64 * sizeof(block) ? bytes - written : 64 * sizeof(block);
+    for (size_t done = 0; done < file_size; done += sizeof(block)) {
+      size_t len = file_size - done < sizeof(block) ? file_size - done : sizeof(block);
+      storage.write(file, block, len);
+      yield();
+    }
+    storage.close(file);
+    written += file_size;
+  }
+  return fillers;
+}
+
+static Result run(MqttNetStorage &storage, const String &md5) {
+  Result result;
+  FileWriter writer(&storage);
+  uint8_t data[chunk];
+  for (int round = 0; round < rounds; round++) {
+    unsigned long started = micros();
+    result.ok = writer.Begin(target, md5.c_str(), size_kb * 1024) && writer.Open() && result.ok;
+    for (size_t pos = 0; pos < size_kb * 1024 && result.ok; pos += chunk) {
+      generate(data, chunk, pos);
+      result.ok = writer.Add(data, chunk);
+      yield();
+    }
+    unsigned long written = micros();
+    result.ok = result.ok && writer.Commit();
+    result.write_us += written - started;
+    result.commit_us += micros() - written;
+  }
+  return result;
+}
+
+static void bench(const char *name, fs::FS &fs, bool littlefs, const String &md5) {
+  fs.format();
+  if (!fs.begin()) {
+    Serial.printf("%-9s mount failed\n", name);
+    return;
+  }
+  FSInfo info;
+  fs.info(info);
+  MqttNetFsStorage storage(fs, littlefs);
+  for (int level = 0; level < 4; level++) {
+    int fillers = fill(storage, info.totalBytes / 4 * level);
+    Result result = run(storage, md5);
+    char filler[16];
+    for (int i = 0; i < fillers; i++) {
+      snprintf(filler, sizeof(filler), "/fill%d", i);
+      storage.remove(filler);
+    }
+    storage.remove(target);
+
+    double kib = size_kb * rounds;
+    Serial.printf("%-9s %3d%% %10.1f KiB/s %10.1f KiB/s  %s\n",
+        name, level * 25,
+        result.write_us ? kib / (result.write_us / 1e6) : 0.0,
+        result.commit_us ? kib / (result.commit_us / 1e6) : 0.0,
+        result.ok ? "ok" : "FAILED");
+  }
+  fs.end();
+}
+
+void setup() {
+  Serial.begin(115200);
+  Serial.println();
+  String md5 = dataMD5();
+  Serial.printf("%u KiB in %u byte chunks, %d rounds per fill level\n", (unsigned)size_kb, (unsigned)chunk, rounds);
+  Serial.println("backend   fill          write         commit");
+  bench("SPIFFS", SPIFFS, false, md5);
+  bench("LittleFS", LittleFS, true, md5);
+}
+
+void loop() {
+}
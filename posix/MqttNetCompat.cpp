@@ -0,0 +1,267 @@
+#include "MqttNetCompat.hpp"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+MqttNetSerial Serial;
+
+static uint64_t uptime_us() {
+  static struct timespec start = {0, 0};
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  if (start.tv_sec == 0 && start.tv_nsec == 0) {
+    start = now;
+  }
+  return (uint64_t)(now.tv_sec - start.tv_sec) * 1000000 + (now.tv_nsec - start.tv_nsec) / 1000;
+}
+
+unsigned long millis() {
+  return (unsigned long)(uptime_us() / 1000);
+}
+
+// wraps at 2^32 like the Arduino micros()
+unsigned long micros() {
+  return (uint32_t)uptime_us();
+}
+
+String::String(int value) : s(std::to_string(value)) {}
+String::String(unsigned int value) : s(std::to_string(value)) {}
+String::String(long value) : s(std::to_string(value)) {}
+String::String(unsigned long value) : s(std::to_string(value)) {}
+String::String(long long value) : s(std::to_string(value)) {}
+String::String(unsigned long long value) : s(std::to_string(value)) {}
+
+String::String(double value, unsigned int decimalPlaces) {
+  char buf[64];
+  snprintf(buf, sizeof(buf), "%.*f", (int)decimalPlaces, value);
+  s = buf;
+}
+
+bool String::endsWith(const String &suffix) const {
+  return s.length() >= suffix.s.length() &&
+         s.compare(s.length() - suffix.s.length(), suffix.s.length(), suffix.s) == 0;
+}
+
+int String::indexOf(char c, unsigned int from) const {
+  size_t pos = s.find(c, from);
+  return pos == std::string::npos ? -1 : (int)pos;
+}
+
+int String::indexOf(const String &str, unsigned int from) const {
+  size_t pos = s.find(str.s, from);
+  return pos == std::string::npos ? -1 : (int)pos;
+}
+
+String String::substring(unsigned int from) const {
+  if (from >= s.length()) {
+    return String();
+  }
+  return String(s.substr(from));
+}
+
+String String::substring(unsigned int from, unsigned int to) const {
+  if (from > to) {
+    unsigned int tmp = from;
+    from = to;
+    to = tmp;
+  }
+  if (from >= s.length()) {
+    return String();
+  }
+  return String(s.substr(from, to - from));
+}
+
+long String::toInt() const {
+  return strtol(s.c_str(), NULL, 10);
+}
+
+void String::toCharArray(char *buf, unsigned int size) const {
+  if (size == 0) {
+    return;
+  }
+  size_t len = s.length() < size - 1 ? s.length() : size - 1;
+  memcpy(buf, s.c_str(), len);
+  buf[len] = 0;
+}
+
+void MqttNetSerial::write(const char *str) {
+  fputs(str, stderr);
+}
+
+void MqttNetSerial::writeNumber(unsigned long long value, bool negative, int base) {
+  char buf[66];
+  char *p = buf + sizeof(buf) - 1;
+  *p = 0;
+  if (base < 2 || base > 16) {
+    base = DEC;
+  }
+  do {
+    *--p = "0123456789ABCDEF"[value % base];
+    value /= base;
+  } while (value > 0);
+  if (negative) {
+    *--p = '-';
+  }
+  write(p);
+}
+
+void MqttNetSerial::print(double value, int digits) {
+  char buf[64];
+  snprintf(buf, sizeof(buf), "%.*f", digits, value);
+  write(buf);
+}
+
+// RFC 1321 MD5, used by FileWriter for the sync protocol checksums.
+
+#define MD5_F(x, y, z) (((x) & (y)) | (~(x) & (z)))
+#define MD5_G(x, y, z) (((x) & (z)) | ((y) & ~(z)))
+#define MD5_H(x, y, z) ((x) ^ (y) ^ (z))
+#define MD5_I(x, y, z) ((y) ^ ((x) | ~(z)))
+#define MD5_ROTATE(x, n) (((x) << (n)) | ((x) >> (32 - (n))))
+#define MD5_STEP(f, a, b, c, d, x, t, s) \
+  (a) += f((b), (c), (d)) + (x) + (uint32_t)(t); \
+  (a) = MD5_ROTATE((a), (s)) + (b);
+
+void MD5Builder::begin() {
+  state[0] = 0x67452301;
+  state[1] = 0xefcdab89;
+  state[2] = 0x98badcfe;
+  state[3] = 0x10325476;
+  count = 0;
+  memset(digest, 0, sizeof(digest));
+}
+
+void MD5Builder::add(const uint8_t *data, size_t len) {
+  size_t used = count % 64;
+  count += len;
+  if (used > 0) {
+    size_t fill = 64 - used;
+    if (len < fill) {
+      memcpy(buffer + used, data, len);
+      return;
+    }
+    memcpy(buffer + used, data, fill);
+    transform(buffer);
+    data += fill;
+    len -= fill;
+  }
+  while (len >= 64) {
+    transform(data);
+    data += 64;
+    len -= 64;
+  }
+  memcpy(buffer, data, len);
+}
+
+void MD5Builder::calculate() {
+  uint64_t bits = count * 8;
+  uint8_t padding[72] = {0x80};
+  size_t used = count % 64;
+  size_t padlen = used < 56 ? 56 - used : 120 - used;
+  uint8_t length[8];
+  for (int i = 0; i < 8; i++) {
+    length[i] = (uint8_t)(bits >> (8 * i));
+  }
+  add(padding, padlen);
+  add(length, 8);
+  for (int i = 0; i < 4; i++) {
+    for (int j = 0; j < 4; j++) {
+      digest[i * 4 + j] = (uint8_t)(state[i] >> (8 * j));
+    }
+  }
+}
+
+void MD5Builder::getChars(char *output) const {
+  for (int i = 0; i < 16; i++) {
+    snprintf(output + i * 2, 3, "%02x", digest[i]);
+  }
+}
+
+String MD5Builder::toString() const {
+  char out[33];
+  getChars(out);
+  return String(out);
+}
+
+void MD5Builder::transform(const uint8_t *block) {
+  uint32_t x[16];
+  for (int i = 0; i < 16; i++) {
+    x[i] = (uint32_t)block[i * 4] | ((uint32_t)block[i * 4 + 1] << 8) |
+           ((uint32_t)block[i * 4 + 2] << 16) | ((uint32_t)block[i * 4 + 3] << 24);
+  }
+  uint32_t a = state[0], b = state[1], c = state[2], d = state[3];
+
+  MD5_STEP(MD5_F, a, b, c, d, x[0], 0xd76aa478, 7)
+  MD5_STEP(MD5_F, d, a, b, c, x[1], 0xe8c7b756, 12)
+  MD5_STEP(MD5_F, c, d, a, b, x[2], 0x242070db, 17)
+  MD5_STEP(MD5_F, b, c, d, a, x[3], 0xc1bdceee, 22)
+  MD5_STEP(MD5_F, a, b, c, d, x[4], 0xf57c0faf, 7)
+  MD5_STEP(MD5_F, d, a, b, c, x[5], 0x4787c62a, 12)
+  MD5_STEP(MD5_F, c, d, a, b, x[6], 0xa8304613, 17)
+  MD5_STEP(MD5_F, b, c, d, a, x[7], 0xfd469501, 22)
+  MD5_STEP(MD5_F, a, b, c, d, x[8], 0x698098d8, 7)
+  MD5_STEP(MD5_F, d, a, b, c, x[9], 0x8b44f7af, 12)
+  MD5_STEP(MD5_F, c, d, a, b, x[10], 0xffff5bb1, 17)
+  MD5_STEP(MD5_F, b, c, d, a, x[11], 0x895cd7be, 22)
+  MD5_STEP(MD5_F, a, b, c, d, x[12], 0x6b901122, 7)
+  MD5_STEP(MD5_F, d, a, b, c, x[13], 0xfd987193, 12)
+  MD5_STEP(MD5_F, c, d, a, b, x[14], 0xa679438e, 17)
+  MD5_STEP(MD5_F, b, c, d, a, x[15], 0x49b40821, 22)
+
+  MD5_STEP(MD5_G, a, b, c, d, x[1], 0xf61e2562, 5)
+  MD5_STEP(MD5_G, d, a, b, c, x[6], 0xc040b340, 9)
+  MD5_STEP(MD5_G, c, d, a, b, x[11], 0x265e5a51, 14)
+  MD5_STEP(MD5_G, b, c, d, a, x[0], 0xe9b6c7aa, 20)
+  MD5_STEP(MD5_G, a, b, c, d, x[5], 0xd62f105d, 5)
+  MD5_STEP(MD5_G, d, a, b, c, x[10], 0x02441453, 9)
+  MD5_STEP(MD5_G, c, d, a, b, x[15], 0xd8a1e681, 14)
+  MD5_STEP(MD5_G, b, c, d, a, x[4], 0xe7d3fbc8, 20)
+  MD5_STEP(MD5_G, a, b, c, d, x[9], 0x21e1cde6, 5)
+  MD5_STEP(MD5_G, d, a, b, c, x[14], 0xc33707d6, 9)
+  MD5_STEP(MD5_G, c, d, a, b, x[3], 0xf4d50d87, 14)
+  MD5_STEP(MD5_G, b, c, d, a, x[8], 0x455a14ed, 20)
+  MD5_STEP(MD5_G, a, b, c, d, x[13], 0xa9e3e905, 5)
+  MD5_STEP(MD5_G, d, a, b, c, x[2], 0xfcefa3f8, 9)
+  MD5_STEP(MD5_G, c, d, a, b, x[7], 0x676f02d9, 14)
+  MD5_STEP(MD5_G, b, c, d, a, x[12], 0x8d2a4c8a, 20)
+
+  MD5_STEP(MD5_H, a, b, c, d, x[5], 0xfffa3942, 4)
+  MD5_STEP(MD5_H, d, a, b, c, x[8], 0x8771f681, 11)
+  MD5_STEP(MD5_H, c, d, a, b, x[11], 0x6d9d6122, 16)
+  MD5_STEP(MD5_H, b, c, d, a, x[14], 0xfde5380c, 23)
+  MD5_STEP(MD5_H, a, b, c, d, x[1], 0xa4beea44, 4)
+  MD5_STEP(MD5_H, d, a, b, c, x[4], 0x4bdecfa9, 11)
+  MD5_STEP(MD5_H, c, d, a, b, x[7], 0xf6bb4b60, 16)
+  MD5_STEP(MD5_H, b, c, d, a, x[10], 0xbebfbc70, 23)
+  MD5_STEP(MD5_H, a, b, c, d, x[13], 0x289b7ec6, 4)
+  MD5_STEP(MD5_H, d, a, b, c, x[0], 0xeaa127fa, 11)
+  MD5_STEP(MD5_H, c, d, a, b, x[3], 0xd4ef3085, 16)
+  MD5_STEP(MD5_H, b, c, d, a, x[6], 0x04881d05, 23)
+  MD5_STEP(MD5_H, a, b, c, d, x[9], 0xd9d4d039, 4)
+  MD5_STEP(MD5_H, d, a, b, c, x[12], 0xe6db99e5, 11)
+  MD5_STEP(MD5_H, c, d, a, b, x[15], 0x1fa27cf8, 16)
+  MD5_STEP(MD5_H, b, c, d, a, x[2], 0xc4ac5665, 23)
+
+  MD5_STEP(MD5_I, a, b, c, d, x[0], 0xf4292244, 6)
+  MD5_STEP(MD5_I, d, a, b, c, x[7], 0x432aff97, 10)
+  MD5_STEP(MD5_I, c, d, a, b, x[14], 0xab9423a7, 15)
+  MD5_STEP(MD5_I, b, c, d, a, x[5], 0xfc93a039, 21)
+  MD5_STEP(MD5_I, a, b, c, d, x[12], 0x655b59c3, 6)
+  MD5_STEP(MD5_I, d, a, b, c, x[3], 0x8f0ccc92, 10)
+  MD5_STEP(MD5_I, c, d, a, b, x[10], 0xffeff47d, 15)
+  MD5_STEP(MD5_I, b, c, d, a, x[1], 0x85845dd1, 21)
+  MD5_STEP(MD5_I, a, b, c, d, x[8], 0x6fa87e4f, 6)
+  MD5_STEP(MD5_I, d, a, b, c, x[15], 0xfe2ce6e0, 10)
+  MD5_STEP(MD5_I, c, d, a, b, x[6], 0xa3014314, 15)
+  MD5_STEP(MD5_I, b, c, d, a, x[13], 0x4e0811a1, 21)
+  MD5_STEP(MD5_I, a, b, c, d, x[4], 0xf7537e82, 6)
+  MD5_STEP(MD5_I, d, a, b, c, x[11], 0xbd3af235, 10)
+  MD5_STEP(MD5_I, c, d, a, b, x[2], 0x2ad7d2bb, 15)
+  MD5_STEP(MD5_I, b, c, d, a, x[9], 0xeb86d391, 21)
+
+  state[0] += a;
+  state[1] += b;
+  state[2] += c;
+  state[3] += d;
+}
@@ -0,0 +1,113 @@
+#ifndef MQTTNETCOMPAT_HPP
+#define MQTTNETCOMPAT_HPP
+
+// Minimal stand-ins for the Arduino core types MqttNet uses, so that the
+// library sources compile unchanged on POSIX hosts.
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+#include <string>
+#include <type_traits>
+
+#define DEC 10
+#define HEX 16
+
+unsigned long millis();
+unsigned long micros();
+
+class String {
+ private:
+  std::string s;
+
+ public:
+  String() {}
+  String(const char *str) : s(str ? str : "") {}
+  String(const std::string &str) : s(str) {}
+  explicit String(char c) : s(1, c) {}
+  explicit String(int value);
+  explicit String(unsigned int value);
+  explicit String(long value);
+  explicit String(unsigned long value);
+  explicit String(long long value);
+  explicit String(unsigned long long value);
+  explicit String(double value, unsigned int decimalPlaces = 2);
+
+  const char *c_str() const { return s.c_str(); }
+  unsigned int length() const { return s.length(); }
+  bool equals(const String &other) const { return s == other.s; }
+  bool equals(const char *other) const { return s == other; }
+  bool startsWith(const String &prefix) const { return s.compare(0, prefix.s.length(), prefix.s) == 0; }
+  bool endsWith(const String &suffix) const;
+  int indexOf(char c, unsigned int from = 0) const;
+  int indexOf(const String &str, unsigned int from = 0) const;
+  String substring(unsigned int from) const;
+  String substring(unsigned int from, unsigned int to) const;
+  long toInt() const;
+  void toCharArray(char *buf, unsigned int size) const;
+  bool reserve(unsigned int size) { s.reserve(size); return true; }
+  char operator[](unsigned int index) const { return index < s.length() ? s[index] : 0; }
+
+  String &operator+=(const String &other) { s += other.s; return *this; }
+  String &operator+=(const char *other) { s += other; return *this; }
+  String &operator+=(char c) { s += c; return *this; }
+  bool operator==(const String &other) const { return s == other.s; }
+  bool operator==(const char *other) const { return s == other; }
+  bool operator!=(const String &other) const { return s != other.s; }
+
+  friend String operator+(const String &a, const String &b) { return String(a.s + b.s); }
+  friend String operator+(const String &a, const char *b) { return String(a.s + b); }
+  friend String operator+(const char *a, const String &b) { return String(a + b.s); }
+  template <typename T>
+  friend typename std::enable_if<std::is_arithmetic<T>::value, String>::type operator+(const String &a, T b) {
+    return a + String(b);
+  }
+};
+
+class MqttNetSerial {
+ private:
+  void write(const char *str);
+  void writeNumber(unsigned long long value, bool negative, int base);
+
+ public:
+  void begin(unsigned long baud) { (void)baud; }
+  void print(const char *str) { write(str); }
+  void print(const String &str) { write(str.c_str()); }
+  void print(char c) { char str[2] = {c, 0}; write(str); }
+  void print(double value, int digits = 2);
+  template <typename T>
+  typename std::enable_if<std::is_integral<T>::value>::type print(T value, int base = DEC) {
+    if (std::is_signed<T>::value && value < 0) {
+      writeNumber(0ULL - (unsigned long long)value, true, base);
+    } else {
+      writeNumber((unsigned long long)value, false, base);
+    }
+  }
+  template <typename T>
+  void println(const T &value) { print(value); write("\n"); }
+  template <typename T>
+  void println(const T &value, int format) { print(value, format); write("\n"); }
+  void println() { write("\n"); }
+};
+
+extern MqttNetSerial Serial;
+
+class MD5Builder {
+ private:
+  uint32_t state[4];
+  uint64_t count;
+  uint8_t buffer[64];
+  uint8_t digest[16];
+  void transform(const uint8_t *block);
+
+ public:
+  void begin();
+  void add(const uint8_t *data, size_t len);
+  void add(const String &str) { add((const uint8_t *)str.c_str(), str.length()); }
+  void calculate();
+  void getBytes(uint8_t *output) const { memcpy(output, digest, 16); }
+  void getChars(char *output) const;
+  String toString() const;
+};
+
+#endif
@@ -0,0 +1,211 @@
+#include "MqttNetEventLoop.hpp"
+
+#include <errno.h>
+#include <sys/epoll.h>
+#include <time.h>
+#include <unistd.h>
+
+#define MQTTNET_EPOLL_EVENTS 256
+
+MqttNetPosixTimer::~MqttNetPosixTimer() {
+  detach();
+}
+
+void MqttNetPosixTimer::setLoop(MqttNetEventLoop *loop) {
+  detach();
+  this->loop = loop;
+}
+
+void MqttNetPosixTimer::attach_ms(uint32_t milliseconds, function_t callback) {
+  detach();
+  this->callback = callback;
+  interval = milliseconds;
+  repeat = true;
+  loop->schedule(this, loop->now() + milliseconds);
+}
+
+void MqttNetPosixTimer::once_ms(uint32_t milliseconds, function_t callback) {
+  detach();
+  this->callback = callback;
+  interval = milliseconds;
+  repeat = false;
+  loop->schedule(this, loop->now() + milliseconds);
+}
+
+// all callbacks run from the loop thread
+void MqttNetPosixTimer::attach_ms_scheduled(uint32_t milliseconds, callback_t callback, void *arg) {
+  attach_ms(milliseconds, std::bind(callback, arg));
+}
+
+void MqttNetPosixTimer::once_ms_scheduled(uint32_t milliseconds, callback_t callback, void *arg) {
+  once_ms(milliseconds, std::bind(callback, arg));
+}
+
+void MqttNetPosixTimer::detach() {
+  if (loop && heapIndex >= 0) {
+    loop->cancel(this);
+  }
+}
+
+MqttNetEventLoop::MqttNetEventLoop() {
+  epollFd = epoll_create1(EPOLL_CLOEXEC);
+  if (epollFd < 0) {
+    Serial.print("MqttNetEventLoop: epoll_create1 failed, errno=");
+    Serial.println(errno, DEC);
+  }
+}
+
+MqttNetEventLoop::~MqttNetEventLoop() {
+  while (!timers.empty()) {
+    cancel(timers.back());
+  }
+  if (epollFd >= 0) {
+    close(epollFd);
+  }
+}
+
+bool MqttNetEventLoop::add(int fd, uint32_t events, MqttNetEventHandler *handler) {
+  struct epoll_event ev;
+  ev.events = events;
+  ev.data.ptr = handler;
+  return epoll_ctl(epollFd, EPOLL_CTL_ADD, fd, &ev) == 0;
+}
+
+bool MqttNetEventLoop::modify(int fd, uint32_t events, MqttNetEventHandler *handler) {
+  struct epoll_event ev;
+  ev.events = events;
+  ev.data.ptr = handler;
+  return epoll_ctl(epollFd, EPOLL_CTL_MOD, fd, &ev) == 0;
+}
+
+void MqttNetEventLoop::remove(int fd) {
+  epoll_ctl(epollFd, EPOLL_CTL_DEL, fd, NULL);
+}
+
+uint64_t MqttNetEventLoop::now() {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+void MqttNetEventLoop::schedule(MqttNetPosixTimer *timer, uint64_t due) {
+  if (timer->heapIndex >= 0) {
+    cancel(timer);
+  }
+  timer->due = due;
+  timer->heapIndex = timers.size();
+  timers.push_back(timer);
+  siftUp(timer->heapIndex);
+}
+
+void MqttNetEventLoop::cancel(MqttNetPosixTimer *timer) {
+  int index = timer->heapIndex;
+  if (index < 0) {
+    return;
+  }
+  size_t last = timers.size() - 1;
+  if ((size_t)index != last) {
+    swapTimers(index, last);
+  }
+  timers.pop_back();
+  timer->heapIndex = -1;
+  if ((size_t)index < timers.size()) {
+    siftDown(index);
+    siftUp(index);
+  }
+}
+
+void MqttNetEventLoop::swapTimers(size_t a, size_t b) {
+  MqttNetPosixTimer *tmp = timers[a];
+  timers[a] = timers[b];
+  timers[b] = tmp;
+  timers[a]->heapIndex = a;
+  timers[b]->heapIndex = b;
+}
+
+void MqttNetEventLoop::siftUp(size_t index) {
+  while (index > 0) {
+    size_t parent = (index - 1) / 2;
+    if (timers[parent]->due <= timers[index]->due) {
+      break;
+    }
+    swapTimers(parent, index);
+    index = parent;
+  }
+}
+
+void MqttNetEventLoop::siftDown(size_t index) {
+  for (;;) {
+    size_t smallest = index;
+    size_t left = index * 2 + 1;
+    size_t right = left + 1;
+    if (left < timers.size() && timers[left]->due < timers[smallest]->due) {
+      smallest = left;
+    }
+    if (right < timers.size() && timers[right]->due < timers[smallest]->due) {
+      smallest = right;
+    }
+    if (smallest == index) {
+      break;
+    }
+    swapTimers(smallest, index);
+    index = smallest;
+  }
+}
+
+int MqttNetEventLoop::nextTimeout(int maxWaitMs) {
+  if (timers.empty()) {
+    return maxWaitMs;
+  }
+  uint64_t t = now();
+  if (timers[0]->due <= t) {
+    return 0;
+  }
+  uint64_t wait = timers[0]->due - t;
+  if (maxWaitMs >= 0 && wait > (uint64_t)maxWaitMs) {
+    return maxWaitMs;
+  }
+  return (int)wait;
+}
+
+void MqttNetEventLoop::runTimers() {
+  uint64_t t = now();
+  // bounded, so that a zero delay timer re-armed from its own callback
+  // cannot keep the loop away from epoll_wait()
+  size_t budget = timers.size();
+  while (budget-- > 0 && !timers.empty() && timers[0]->due <= t) {
+    MqttNetPosixTimer *timer = timers[0];
+    MqttNetPosixTimer::function_t callback = timer->callback;
+    if (timer->repeat) {
+      uint32_t interval = timer->interval > 0 ? timer->interval : 1;
+      uint64_t due = timer->due + interval;
+      schedule(timer, due > t ? due : t + interval);
+    } else {
+      cancel(timer);
+    }
+    if (callback) {
+      callback();
+    }
+  }
+}
+
+void MqttNetEventLoop::runOnce(int maxWaitMs) {
+  struct epoll_event events[MQTTNET_EPOLL_EVENTS];
+  int n = epoll_wait(epollFd, events, MQTTNET_EPOLL_EVENTS, nextTimeout(maxWaitMs));
+  for (int i = 0; i < n; i++) {
+    MqttNetEventHandler *handler = (MqttNetEventHandler *)events[i].data.ptr;
+    handler->onEvents(events[i].events);
+  }
+  runTimers();
+}
+
+void MqttNetEventLoop::run() {
+  running = true;
+  while (running) {
+    runOnce(-1);
+  }
+}
+
+void MqttNetEventLoop::stop() {
+  running = false;
+}
@@ -0,0 +1,70 @@
+#ifndef MQTTNETEVENTLOOP_HPP
+#define MQTTNETEVENTLOOP_HPP
+
+#include <stdint.h>
+#include <vector>
+
+#include "../MqttNetPlatform.hpp"
+
+class MqttNetEventLoop;
+
+class MqttNetEventHandler {
+ public:
+  virtual ~MqttNetEventHandler() {}
+  virtual void onEvents(uint32_t events) = 0;
+};
+
+// Timer driven by a MqttNetEventLoop. All timers of a loop share one heap,
+// so thousands of MqttNet instances cost no threads and no extra fds.
+class MqttNetPosixTimer : public MqttNetTimer {
+  friend class MqttNetEventLoop;
+
+ public:
+  typedef std::function<void()> function_t;
+
+ private:
+  MqttNetEventLoop *loop;
+  function_t callback;
+  uint64_t due = 0;
+  uint32_t interval = 0;
+  bool repeat = false;
+  int heapIndex = -1;
+
+ public:
+  explicit MqttNetPosixTimer(MqttNetEventLoop *loop = nullptr) : loop(loop) {}
+  ~MqttNetPosixTimer();
+  void setLoop(MqttNetEventLoop *loop);
+  void attach_ms(uint32_t milliseconds, function_t callback);
+  void once_ms(uint32_t milliseconds, function_t callback);
+  void attach_ms_scheduled(uint32_t milliseconds, callback_t callback, void *arg);
+  void once_ms_scheduled(uint32_t milliseconds, callback_t callback, void *arg);
+  void detach();
+  bool active() const { return heapIndex >= 0; }
+};
+
+class MqttNetEventLoop {
+ private:
+  int epollFd;
+  bool running = false;
+  std::vector<MqttNetPosixTimer *> timers;
+  void siftUp(size_t index);
+  void siftDown(size_t index);
+  void swapTimers(size_t a, size_t b);
+  int nextTimeout(int maxWaitMs);
+  void runTimers();
+
+ public:
+  MqttNetEventLoop();
+  ~MqttNetEventLoop();
+  bool add(int fd, uint32_t events, MqttNetEventHandler *handler);
+  bool modify(int fd, uint32_t events, MqttNetEventHandler *handler);
+  void remove(int fd);
+  void schedule(MqttNetPosixTimer *timer, uint64_t due);
+  void cancel(MqttNetPosixTimer *timer);
+  uint64_t now();
+  void runOnce(int maxWaitMs);
+  void run();
+  void stop();
+};
+
+#endif
@@ -0,0 +1,142 @@
+#include "MqttNetMemoryStorage.hpp"
+
+#include <string.h>
+
+MqttNetMemoryStorage::MqttNetMemoryStorage(size_t capacity) : _capacity(capacity), _used(0) {}
+
+MqttNetMemoryStorage::Handle *MqttNetMemoryStorage::handle(int handle) {
+  if (handle < 0 || (size_t)handle >= handles.size() || !handles[handle].file) {
+    return nullptr;
+  }
+  return &handles[handle];
+}
+
+int MqttNetMemoryStorage::open(const char *path, const char *mode) {
+  std::map<std::string, file_t>::iterator it = files.find(path);
+  if (mode[0] == 'w' || mode[0] == 'a') {
+    if (it == files.end()) {
+      it = files.insert(std::make_pair(std::string(path), std::make_shared<std::vector<uint8_t>>())).first;
+    } else if (mode[0] == 'w') {
+      _used -= it->second->size();
+      it->second->clear();
+    }
+  } else if (it == files.end()) {
+    return -1;
+  }
+  size_t slot = 0;
+  while (slot < handles.size() && handles[slot].file) {
+    slot++;
+  }
+  if (slot == handles.size()) {
+    handles.push_back(Handle());
+  }
+  handles[slot].file = it->second;
+  handles[slot].pos = 0;
+  handles[slot].append = mode[0] == 'a';
+  return slot;
+}
+
+size_t MqttNetMemoryStorage::read(int handle, uint8_t *data, size_t len) {
+  Handle *h = this->handle(handle);
+  if (!h || h->pos >= h->file->size()) {
+    return 0;
+  }
+  if (len > h->file->size() - h->pos) {
+    len = h->file->size() - h->pos;
+  }
+  memcpy(data, h->file->data() + h->pos, len);
+  h->pos += len;
+  return len;
+}
+
+size_t MqttNetMemoryStorage::write(int handle, const uint8_t *data, size_t len) {
+  Handle *h = this->handle(handle);
+  if (!h) {
+    return 0;
+  }
+  if (h->append) {
+    h->pos = h->file->size();
+  }
+  size_t end = h->pos + len;
+  if (end > h->file->size()) {
+    size_t grow = end - h->file->size();
+    if (_capacity > 0 && _used + grow > _capacity) {
+      return 0;
+    }
+    h->file->resize(end);
+    _used += grow;
+  }
+  memcpy(h->file->data() + h->pos, data, len);
+  h->pos = end;
+  return len;
+}
+
+bool MqttNetMemoryStorage::seek(int handle, size_t pos) {
+  Handle *h = this->handle(handle);
+  if (!h || pos > h->file->size()) {
+    return false;
+  }
+  h->pos = pos;
+  return true;
+}
+
+size_t MqttNetMemoryStorage::size(int handle) {
+  Handle *h = this->handle(handle);
+  return h ? h->file->size() : 0;
+}
+
+void MqttNetMemoryStorage::close(int handle) {
+  Handle *h = this->handle(handle);
+  if (h) {
+    h->file.reset();
+  }
+}
+
+bool MqttNetMemoryStorage::exists(const char *path) {
+  return files.count(path) > 0;
+}
+
+bool MqttNetMemoryStorage::remove(const char *path) {
+  std::map<std::string, file_t>::iterator it = files.find(path);
+  if (it == files.end()) {
+    return false;
+  }
+  _used -= it->second->size();
+  files.erase(it);
+  return true;
+}
+
+bool MqttNetMemoryStorage::rename(const char *from, const char *to) {
+  std::map<std::string, file_t>::iterator it = files.find(from);
+  if (it == files.end()) {
+    return false;
+  }
+  file_t file = it->second;
+  files.erase(it);
+  remove(to);
+  files[to] = file;
+  return true;
+}
+
+bool MqttNetMemoryStorage::mkdir(const char *path) {
+  (void)path;
+  return true;
+}
+
+bool MqttNetMemoryStorage::renameReplaces() {
+  return true;
+}
+
+size_t MqttNetMemoryStorage::used() {
+  return _used;
+}
+
+size_t MqttNetMemoryStorage::capacity() {
+  return _capacity;
+}
+
+void MqttNetMemoryStorage::clear() {
+  files.clear();
+  handles.clear();
+  _used = 0;
+}
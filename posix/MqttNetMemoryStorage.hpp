@@ -0,0 +1,49 @@
+#ifndef MQTTNETMEMORYSTORAGE_HPP
+#define MQTTNETMEMORYSTORAGE_HPP
+
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "MqttNetPlatform.hpp"
+
+// Files kept in RAM, for host tests and benchmarks that should not depend on
+// the disk. An optional capacity makes writes fail like on a full flash
+// file system. Renames replace their target, directories are implicit.
+class MqttNetMemoryStorage : public MqttNetStorage {
+ private:
+  typedef std::shared_ptr<std::vector<uint8_t>> file_t;
+  struct Handle {
+    file_t file;
+    size_t pos;
+    bool append;
+  };
+  std::map<std::string, file_t> files;
+  std::vector<Handle> handles;
+  size_t _capacity;
+  size_t _used;
+
+  Handle *handle(int handle);
+
+ public:
+  explicit MqttNetMemoryStorage(size_t capacity = 0);
+  int open(const char *path, const char *mode);
+  size_t read(int handle, uint8_t *data, size_t len);
+  size_t write(int handle, const uint8_t *data, size_t len);
+  bool seek(int handle, size_t pos);
+  size_t size(int handle);
+  void close(int handle);
+  bool exists(const char *path);
+  bool remove(const char *path);
+  bool rename(const char *from, const char *to);
+  bool mkdir(const char *path);
+  bool renameReplaces();
+
+  // bytes held by all files, 0 for capacity means unlimited
+  size_t used();
+  size_t capacity();
+  void clear();
+};
+
+#endif
@@ -0,0 +1,166 @@
+#include "MqttNetPosix.hpp"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/resource.h>
+#include <sys/stat.h>
+#include <sys/utsname.h>
+#include <unistd.h>
+
+void MqttNetPosixNetwork::onConnect(event_handler_t handler) {
+  handler();
+}
+
+void MqttNetPosixNetwork::onDisconnect(event_handler_t handler) {
+  (void)handler;
+}
+
+bool MqttNetPosixNetwork::isConnected() {
+  return true;
+}
+
+String MqttNetPosixNetwork::localAddress() {
+  char hostname[256];
+  if (gethostname(hostname, sizeof(hostname)) != 0) {
+    return String("");
+  }
+  hostname[sizeof(hostname) - 1] = 0;
+  return String(hostname);
+}
+
+MqttNetPosixStorage::MqttNetPosixStorage(const char *root) : root(root) {
+  ::mkdir(root, 0755);
+}
+
+// Paths stay below the root: absolute paths and empty or ".." segments
+// are refused, so remote file names cannot leave the instance directory.
+bool MqttNetPosixStorage::resolve(const char *path, std::string *full) {
+  const char *segment = path;
+  for (;;) {
+    const char *end = strchr(segment, '/');
+    size_t len = end ? (size_t)(end - segment) : strlen(segment);
+    if (len == 0 || (len == 2 && segment[0] == '.' && segment[1] == '.')) {
+      return false;
+    }
+    if (!end) {
+      break;
+    }
+    segment = end + 1;
+  }
+  *full = root + "/" + path;
+  return true;
+}
+
+int MqttNetPosixStorage::open(const char *path, const char *mode) {
+  int flags = O_RDONLY;
+  if (mode[0] == 'w') {
+    flags = O_RDWR | O_CREAT | O_TRUNC;
+  } else if (mode[0] == 'a') {
+    flags = O_RDWR | O_CREAT | O_APPEND;
+  } else if (mode[1] == '+') {
+    flags = O_RDWR;
+  }
+  std::string full;
+  if (!resolve(path, &full)) {
+    return -1;
+  }
+  return ::open(full.c_str(), flags | O_CLOEXEC, 0644);
+}
+
+size_t MqttNetPosixStorage::read(int handle, uint8_t *data, size_t len) {
+  ssize_t n = ::read(handle, data, len);
+  return n > 0 ? n : 0;
+}
+
+size_t MqttNetPosixStorage::write(int handle, const uint8_t *data, size_t len) {
+  ssize_t n = ::write(handle, data, len);
+  return n > 0 ? n : 0;
+}
+
+bool MqttNetPosixStorage::seek(int handle, size_t pos) {
+  return lseek(handle, pos, SEEK_SET) == (off_t)pos;
+}
+
+size_t MqttNetPosixStorage::size(int handle) {
+  struct stat st;
+  if (fstat(handle, &st) != 0) {
+    return 0;
+  }
+  return st.st_size;
+}
+
+void MqttNetPosixStorage::close(int handle) {
+  ::close(handle);
+}
+
+bool MqttNetPosixStorage::exists(const char *path) {
+  std::string full;
+  return resolve(path, &full) && access(full.c_str(), F_OK) == 0;
+}
+
+bool MqttNetPosixStorage::remove(const char *path) {
+  std::string full;
+  return resolve(path, &full) && unlink(full.c_str()) == 0;
+}
+
+bool MqttNetPosixStorage::rename(const char *from, const char *to) {
+  std::string full_from;
+  std::string full_to;
+  return resolve(from, &full_from) && resolve(to, &full_to) && ::rename(full_from.c_str(), full_to.c_str()) == 0;
+}
+
+bool MqttNetPosixStorage::mkdir(const char *path) {
+  std::string full;
+  if (!resolve(path, &full)) {
+    return false;
+  }
+  for (size_t slash = full.find('/', root.length() + 1); slash != std::string::npos; slash = full.find('/', slash + 1)) {
+    ::mkdir(full.substr(0, slash).c_str(), 0755);
+  }
+  return ::mkdir(full.c_str(), 0755) == 0 || errno == EEXIST;
+}
+
+bool MqttNetPosixStorage::renameReplaces() {
+  return true;
+}
+
+MqttNetPosix::MqttNetPosix(MqttNetEventLoop &loop, const char *storageRoot) : _client(&loop), _storage(storageRoot) {
+  for (int i = 0; i < MQTTNET_TIMER_COUNT; i++) {
+    _timers[i].setLoop(&loop);
+  }
+}
+
+MqttNetClient &MqttNetPosix::client() {
+  return _client;
+}
+
+MqttNetTimer &MqttNetPosix::timer(MqttNetTimerId id) {
+  return _timers[id];
+}
+
+MqttNetNetwork &MqttNetPosix::network() {
+  return _network;
+}
+
+MqttNetStorage &MqttNetPosix::storage() {
+  return _storage;
+}
+
+void MqttNetPosix::publishMetadata(publish_t publish) {
+  struct utsname uts;
+  if (uname(&uts) == 0) {
+    publish("net/posix/sysname", String(uts.sysname));
+    publish("net/posix/release", String(uts.release));
+    publish("net/posix/machine", String(uts.machine));
+  }
+  publish("net/posix/pid", String((long)getpid()));
+}
+
+void MqttNetPosix::publishStats(publish_t publish) {
+  struct rusage usage;
+  if (getrusage(RUSAGE_SELF, &usage) == 0) {
+    publish("net/posix/max_rss_kb", String(usage.ru_maxrss));
+  }
+}
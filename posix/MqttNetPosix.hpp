@@ -0,0 +1,57 @@
+#ifndef MQTTNETPOSIX_HPP
+#define MQTTNETPOSIX_HPP
+
+#include <string>
+
+#include "MqttNetEventLoop.hpp"
+#include "MqttNetPosixClient.hpp"
+
+// The host network is managed by the operating system, so this backend
+// reports the interface as permanently up.
+class MqttNetPosixNetwork : public MqttNetNetwork {
+ public:
+  void onConnect(event_handler_t handler);
+  void onDisconnect(event_handler_t handler);
+  bool isConnected();
+  String localAddress();
+};
+
+// Plain files below a root directory, one directory per MqttNet instance.
+class MqttNetPosixStorage : public MqttNetStorage {
+ private:
+  std::string root;
+  bool resolve(const char *path, std::string *full);
+
+ public:
+  explicit MqttNetPosixStorage(const char *root);
+  int open(const char *path, const char *mode);
+  size_t read(int handle, uint8_t *data, size_t len);
+  size_t write(int handle, const uint8_t *data, size_t len);
+  bool seek(int handle, size_t pos);
+  size_t size(int handle);
+  void close(int handle);
+  bool exists(const char *path);
+  bool remove(const char *path);
+  bool rename(const char *from, const char *to);
+  bool mkdir(const char *path);
+  bool renameReplaces();
+};
+
+class MqttNetPosix : public MqttNetPlatform {
+ private:
+  MqttNetPosixClient _client;
+  MqttNetPosixTimer _timers[MQTTNET_TIMER_COUNT];
+  MqttNetPosixNetwork _network;
+  MqttNetPosixStorage _storage;
+
+ public:
+  MqttNetPosix(MqttNetEventLoop &loop, const char *storageRoot);
+  MqttNetClient &client();
+  MqttNetTimer &timer(MqttNetTimerId id);
+  MqttNetNetwork &network();
+  MqttNetStorage &storage();
+  void publishMetadata(publish_t publish);
+  void publishStats(publish_t publish);
+};
+
+#endif
@@ -0,0 +1,603 @@
+#include "MqttNetPosixClient.hpp"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <stdio.h>
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#define MQTT_CONNECT 0x10
+#define MQTT_CONNACK 0x20
+#define MQTT_PUBLISH 0x30
+#define MQTT_PUBACK 0x40
+#define MQTT_PUBREC 0x50
+#define MQTT_PUBREL 0x62
+#define MQTT_PUBCOMP 0x70
+#define MQTT_SUBSCRIBE 0x82
+#define MQTT_SUBACK 0x90
+#define MQTT_UNSUBSCRIBE 0xA2
+#define MQTT_UNSUBACK 0xB0
+#define MQTT_PINGREQ 0xC0
+#define MQTT_PINGRESP 0xD0
+#define MQTT_DISCONNECT 0xE0
+
+MqttNetPosixClient::MqttNetPosixClient(MqttNetEventLoop *loop) : loop(loop), keepaliveTimer(loop), resumeTimer(loop) {
+  static unsigned int instances = 0;
+  char id[32];
+  snprintf(id, sizeof(id), "mqttnet-%d-%u", (int)getpid(), instances++);
+  clientId = id;
+}
+
+MqttNetPosixClient::~MqttNetPosixClient() {
+  disconnectHandler = nullptr;
+  closeSocket(MqttNetDisconnectReason::TCP_DISCONNECTED);
+}
+
+void MqttNetPosixClient::onConnect(connect_handler_t handler) {
+  connectHandler = handler;
+}
+
+void MqttNetPosixClient::onDisconnect(disconnect_handler_t handler) {
+  disconnectHandler = handler;
+}
+
+void MqttNetPosixClient::onMessage(message_handler_t handler) {
+  messageHandler = handler;
+}
+
+void MqttNetPosixClient::onSubscribe(subscribe_handler_t handler) {
+  subscribeHandler = handler;
+}
+
+void MqttNetPosixClient::setClientId(const char *clientId) {
+  this->clientId = clientId;
+}
+
+void MqttNetPosixClient::setServer(const char *host, uint16_t port) {
+  this->host = host;
+  this->port = port;
+}
+
+void MqttNetPosixClient::setSecure(bool secure) {
+  this->secure = secure;
+}
+
+void MqttNetPosixClient::setCredentials(const char *username, const char *password) {
+  this->username = username ? username : "";
+  this->password = password ? password : "";
+}
+
+void MqttNetPosixClient::setWill(const char *topic, uint8_t qos, bool retain, const char *payload) {
+  willTopic = topic ? topic : "";
+  willPayload = payload ? payload : "";
+  willQos = qos;
+  willRetain = retain;
+}
+
+void MqttNetPosixClient::setCleanSession(bool cleanSession) {
+  this->cleanSession = cleanSession;
+}
+
+// takes effect with the next connect()
+void MqttNetPosixClient::setKeepAlive(uint16_t seconds) {
+  keepAlive = seconds;
+}
+
+void MqttNetPosixClient::connect() {
+  if (state != DISCONNECTED) {
+    return;
+  }
+  if (secure) {
+    Serial.println("MqttNetPosixClient: TLS is not supported");
+    if (disconnectHandler) {
+      disconnectHandler(MqttNetDisconnectReason::TLS_BAD_FINGERPRINT);
+    }
+    return;
+  }
+
+  // getaddrinfo() blocks for host names; gateways with many instances
+  // should configure a numeric broker address
+  struct addrinfo hints = {};
+  struct addrinfo *result = NULL;
+  char service[8];
+  hints.ai_family = AF_UNSPEC;
+  hints.ai_socktype = SOCK_STREAM;
+  hints.ai_flags = AI_NUMERICSERV;
+  snprintf(service, sizeof(service), "%u", (unsigned int)port);
+  if (getaddrinfo(host.c_str(), service, &hints, &result) != 0 || result == NULL) {
+    Serial.print("MqttNetPosixClient: cannot resolve ");
+    Serial.println(host.c_str());
+    if (disconnectHandler) {
+      disconnectHandler(MqttNetDisconnectReason::TCP_DISCONNECTED);
+    }
+    return;
+  }
+
+  fd = socket(result->ai_family, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+  if (fd < 0) {
+    freeaddrinfo(result);
+    if (disconnectHandler) {
+      disconnectHandler(MqttNetDisconnectReason::TCP_DISCONNECTED);
+    }
+    return;
+  }
+  int one = 1;
+  setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+
+  outbound.clear();
+  outboundOffset = 0;
+  inbound.clear();
+  deliverOffset = 0;
+  state = CONNECTING;
+  int rc = ::connect(fd, result->ai_addr, result->ai_addrlen);
+  freeaddrinfo(result);
+  if (rc != 0 && errno != EINPROGRESS) {
+    closeSocket(MqttNetDisconnectReason::TCP_DISCONNECTED);
+    return;
+  }
+  wantRead = !paused;
+  wantWrite = true;
+  loop->add(fd, (wantRead ? (uint32_t)EPOLLIN : 0) | (uint32_t)EPOLLOUT, this);
+}
+
+void MqttNetPosixClient::disconnect() {
+  if (state == CONNECTED) {
+    appendHeader(MQTT_DISCONNECT, 0);
+    flush();
+  }
+  closeSocket(MqttNetDisconnectReason::TCP_DISCONNECTED);
+}
+
+bool MqttNetPosixClient::connected() {
+  return state == CONNECTED;
+}
+
+uint16_t MqttNetPosixClient::packetId() {
+  uint16_t id = nextPacketId++;
+  if (nextPacketId == 0) {
+    nextPacketId = 1;
+  }
+  return id;
+}
+
+bool MqttNetPosixClient::hasRoom(size_t len) {
+  return outbound.size() - outboundOffset + len <= MQTTNET_POSIX_MAX_OUTBOUND;
+}
+
+void MqttNetPosixClient::appendHeader(uint8_t type, size_t remaining) {
+  outbound.push_back(type);
+  do {
+    uint8_t digit = remaining % 128;
+    remaining /= 128;
+    if (remaining > 0) {
+      digit |= 0x80;
+    }
+    outbound.push_back(digit);
+  } while (remaining > 0);
+}
+
+void MqttNetPosixClient::appendUint16(uint16_t value) {
+  outbound.push_back(value >> 8);
+  outbound.push_back(value & 0xff);
+}
+
+void MqttNetPosixClient::appendString(const char *str, size_t len) {
+  appendUint16(len);
+  outbound.insert(outbound.end(), (const uint8_t *)str, (const uint8_t *)str + len);
+}
+
+void MqttNetPosixClient::appendAck(uint8_t type, uint16_t id) {
+  appendHeader(type, 2);
+  appendUint16(id);
+}
+
+void MqttNetPosixClient::sendConnect() {
+  uint8_t flags = 0;
+  size_t remaining = 10 + 2 + clientId.length();
+  if (cleanSession) {
+    flags |= 0x02;
+  }
+  if (willTopic.length() > 0) {
+    flags |= 0x04 | (willQos << 3) | (willRetain ? 0x20 : 0);
+    remaining += 2 + willTopic.length() + 2 + willPayload.length();
+  }
+  if (username.length() > 0) {
+    flags |= 0x80;
+    remaining += 2 + username.length();
+    if (password.length() > 0) {
+      flags |= 0x40;
+      remaining += 2 + password.length();
+    }
+  }
+  appendHeader(MQTT_CONNECT, remaining);
+  appendString("MQTT", 4);
+  outbound.push_back(4);
+  outbound.push_back(flags);
+  appendUint16(keepAlive);
+  appendString(clientId.c_str(), clientId.length());
+  if (flags & 0x04) {
+    appendString(willTopic.c_str(), willTopic.length());
+    appendString(willPayload.c_str(), willPayload.length());
+  }
+  if (flags & 0x80) {
+    appendString(username.c_str(), username.length());
+  }
+  if (flags & 0x40) {
+    appendString(password.c_str(), password.length());
+  }
+  state = WAIT_CONNACK;
+  pingPending = false;
+  lastReceived = loop->now();
+  keepaliveTimer.attach_ms(1000, std::bind(&MqttNetPosixClient::keepalive, this));
+  flush();
+}
+
+uint16_t MqttNetPosixClient::subscribe(const char *topic, uint8_t qos) {
+  uint16_t id = 0;
+  return subscribe(&topic, &qos, 1, &id) == 1 ? id : 0;
+}
+
+size_t MqttNetPosixClient::subscribe(const char *const *topics, const uint8_t *qos, size_t count, uint16_t *packetIds) {
+  size_t remaining = 2;
+  for (size_t i = 0; i < count; i++) {
+    remaining += 2 + strlen(topics[i]) + 1;
+  }
+  if (count == 0 || state != CONNECTED || !hasRoom(remaining + 5)) {
+    return 0;
+  }
+  uint16_t id = packetId();
+  appendHeader(MQTT_SUBSCRIBE, remaining);
+  appendUint16(id);
+  for (size_t i = 0; i < count; i++) {
+    appendString(topics[i], strlen(topics[i]));
+    outbound.push_back(qos[i]);
+    packetIds[i] = id;
+  }
+  flush();
+  return count;
+}
+
+void MqttNetPosixClient::pauseReceive(bool pause) {
+  if (paused == pause) {
+    return;
+  }
+  paused = pause;
+  if (fd >= 0 && state != CONNECTING) {
+    updateEvents();
+  }
+  if (!paused) {
+    // packets already read from the socket are not signalled by epoll again
+    resumeTimer.once_ms(0, std::bind(&MqttNetPosixClient::resumeReceive, this));
+  }
+}
+
+void MqttNetPosixClient::resumeReceive() {
+  if (fd >= 0 && !paused && state != CONNECTING) {
+    parseInbound();
+  }
+}
+
+uint16_t MqttNetPosixClient::unsubscribe(const char *topic) {
+  size_t tlen = strlen(topic);
+  size_t remaining = 2 + 2 + tlen;
+  if (state != CONNECTED || !hasRoom(remaining + 5)) {
+    return 0;
+  }
+  uint16_t id = packetId();
+  appendHeader(MQTT_UNSUBSCRIBE, remaining);
+  appendUint16(id);
+  appendString(topic, tlen);
+  flush();
+  return id;
+}
+
+uint16_t MqttNetPosixClient::publish(const char *topic, uint8_t qos, bool retain, const char *payload, size_t length) {
+  size_t tlen = strlen(topic);
+  size_t remaining = 2 + tlen + (qos > 0 ? 2 : 0) + length;
+  if (state != CONNECTED || !hasRoom(remaining + 5)) {
+    return 0;
+  }
+  uint16_t id = qos > 0 ? packetId() : 1;
+  appendHeader(MQTT_PUBLISH | (qos << 1) | (retain ? 1 : 0), remaining);
+  appendString(topic, tlen);
+  if (qos > 0) {
+    appendUint16(id);
+  }
+  if (length > 0) {
+    outbound.insert(outbound.end(), (const uint8_t *)payload, (const uint8_t *)payload + length);
+  }
+  flush();
+  return id;
+}
+
+void MqttNetPosixClient::flush() {
+  if (fd < 0 || state == CONNECTING) {
+    return;
+  }
+  while (outboundOffset < outbound.size()) {
+    ssize_t n = send(fd, &outbound[outboundOffset], outbound.size() - outboundOffset, MSG_NOSIGNAL);
+    if (n > 0) {
+      outboundOffset += n;
+      lastSent = loop->now();
+    } else if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+      break;
+    } else if (n < 0 && errno == EINTR) {
+      continue;
+    } else {
+      closeSocket(MqttNetDisconnectReason::TCP_DISCONNECTED);
+      return;
+    }
+  }
+  if (outboundOffset == outbound.size()) {
+    outbound.clear();
+    outboundOffset = 0;
+  } else if (outboundOffset > MQTTNET_POSIX_MAX_OUTBOUND / 2) {
+    outbound.erase(outbound.begin(), outbound.begin() + outboundOffset);
+    outboundOffset = 0;
+  }
+  updateEvents();
+}
+
+void MqttNetPosixClient::updateEvents() {
+  bool read = !paused;
+  bool write = state == CONNECTING || outboundOffset < outbound.size();
+  if (read != wantRead || write != wantWrite) {
+    wantRead = read;
+    wantWrite = write;
+    loop->modify(fd, (read ? (uint32_t)EPOLLIN : 0) | (write ? (uint32_t)EPOLLOUT : 0), this);
+  }
+}
+
+void MqttNetPosixClient::onEvents(uint32_t events) {
+  if (fd < 0) {
+    return;
+  }
+  if (state == CONNECTING) {
+    int err = 0;
+    socklen_t errlen = sizeof(err);
+    if (getsockopt(fd, SOL_SOCKET, SO_ERROR, &err, &errlen) != 0 || err != 0 || (events & (EPOLLERR | EPOLLHUP))) {
+      closeSocket(MqttNetDisconnectReason::TCP_DISCONNECTED);
+      return;
+    }
+    if (!(events & EPOLLOUT)) {
+      return;
+    }
+    state = WAIT_CONNACK;
+    sendConnect();
+    return;
+  }
+  if (paused && (events & (EPOLLERR | EPOLLHUP))) {
+    closeSocket(MqttNetDisconnectReason::TCP_DISCONNECTED);
+    return;
+  }
+  if (events & (EPOLLIN | EPOLLERR | EPOLLHUP)) {
+    readAvailable();
+  }
+  if (fd >= 0 && (events & EPOLLOUT)) {
+    flush();
+  }
+}
+
+void MqttNetPosixClient::readAvailable() {
+  uint8_t buf[4096];
+  while (!paused) {
+    ssize_t n = recv(fd, buf, sizeof(buf), 0);
+    if (n == 0) {
+      closeSocket(MqttNetDisconnectReason::TCP_DISCONNECTED);
+      return;
+    }
+    if (n < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      if (errno != EAGAIN && errno != EWOULDBLOCK) {
+        closeSocket(MqttNetDisconnectReason::TCP_DISCONNECTED);
+      }
+      return;
+    }
+    lastReceived = loop->now();
+    inbound.insert(inbound.end(), buf, buf + n);
+    if (!parseInbound()) {
+      return;
+    }
+  }
+}
+
+// Handles the complete packets in inbound, returns false if the socket was
+// closed.
+bool MqttNetPosixClient::parseInbound() {
+  size_t pos = 0;
+  while (!paused && inbound.size() - pos >= 2) {
+    size_t remaining = 0;
+    size_t multiplier = 1;
+    size_t hdrlen = 1;
+    bool complete = false;
+    while (hdrlen < 5 && pos + hdrlen < inbound.size()) {
+      uint8_t digit = inbound[pos + hdrlen];
+      remaining += (digit & 0x7f) * multiplier;
+      multiplier *= 128;
+      hdrlen++;
+      if (!(digit & 0x80)) {
+        complete = true;
+        break;
+      }
+    }
+    if (!complete) {
+      if (hdrlen >= 5) {
+        closeSocket(MqttNetDisconnectReason::TCP_DISCONNECTED);
+        return false;
+      }
+      break;
+    }
+    if (remaining > MQTTNET_POSIX_MAX_PACKET) {
+      Serial.println("MqttNetPosixClient: inbound packet too large");
+      closeSocket(MqttNetDisconnectReason::TCP_DISCONNECTED);
+      return false;
+    }
+    if (inbound.size() - pos < hdrlen + remaining) {
+      break;
+    }
+    if (!handlePacket(inbound[pos], &inbound[pos + hdrlen], remaining)) {
+      closeSocket(MqttNetDisconnectReason::TCP_DISCONNECTED);
+      return false;
+    }
+    if (fd < 0) {
+      return false;
+    }
+    if (deliverOffset > 0) {
+      // paused halfway through a publish, the rest follows on resume
+      break;
+    }
+    pos += hdrlen + remaining;
+  }
+  inbound.erase(inbound.begin(), inbound.begin() + pos);
+  return true;
+}
+
+bool MqttNetPosixClient::handlePacket(uint8_t header, const uint8_t *data, size_t len) {
+  uint8_t type = header & 0xf0;
+  if (state == WAIT_CONNACK) {
+    if (type != MQTT_CONNACK || len < 2) {
+      return false;
+    }
+    if (data[1] != 0) {
+      closeSocket((MqttNetDisconnectReason)data[1]);
+      return true;
+    }
+    state = CONNECTED;
+    if (connectHandler) {
+      connectHandler(data[0] & 0x01);
+    }
+    flush();
+    return true;
+  }
+  switch (type) {
+    case MQTT_PUBLISH:
+      handlePublish(header, data, len);
+      return true;
+    case MQTT_PUBREC:
+      if (len < 2) {
+        return false;
+      }
+      appendAck(MQTT_PUBREL, (data[0] << 8) | data[1]);
+      flush();
+      return true;
+    case MQTT_PUBREL & 0xf0:
+      if (len < 2) {
+        return false;
+      }
+      appendAck(MQTT_PUBCOMP, (data[0] << 8) | data[1]);
+      flush();
+      return true;
+    case MQTT_SUBACK:
+      if (len < 3) {
+        return false;
+      }
+      if (subscribeHandler) {
+        subscribeHandler((data[0] << 8) | data[1], data + 2, len - 2);
+      }
+      return true;
+    case MQTT_PINGRESP:
+      pingPending = false;
+      return true;
+    case MQTT_PUBACK:
+    case MQTT_PUBCOMP:
+    case MQTT_UNSUBACK:
+      return true;
+    default:
+      return false;
+  }
+}
+
+void MqttNetPosixClient::handlePublish(uint8_t header, const uint8_t *data, size_t len) {
+  MqttNetMessageProperties properties;
+  properties.qos = (header >> 1) & 0x03;
+  properties.dup = header & 0x08;
+  properties.retain = header & 0x01;
+  if (len < 2) {
+    return;
+  }
+  size_t tlen = (data[0] << 8) | data[1];
+  size_t offset = 2 + tlen;
+  uint16_t id = 0;
+  if (properties.qos > 0) {
+    if (len < offset + 2) {
+      return;
+    }
+    id = (data[offset] << 8) | data[offset + 1];
+    offset += 2;
+  }
+  if (len < offset) {
+    return;
+  }
+  topicBuffer.assign((const char *)data + 2, (const char *)data + 2 + tlen);
+  topicBuffer.push_back(0);
+  size_t plen = len - offset;
+  do {
+    size_t chunk = plen - deliverOffset < MQTTNET_POSIX_RX_CHUNK ? plen - deliverOffset : MQTTNET_POSIX_RX_CHUNK;
+    if (messageHandler) {
+      messageHandler(&topicBuffer[0], (char *)data + offset + deliverOffset, properties, chunk, deliverOffset, plen);
+    }
+    if (fd < 0) {
+      return;
+    }
+    deliverOffset += chunk;
+  } while (deliverOffset < plen && !paused);
+  if (deliverOffset < plen) {
+    return;
+  }
+  deliverOffset = 0;
+  if (properties.qos == 1) {
+    appendAck(MQTT_PUBACK, id);
+    flush();
+  } else if (properties.qos == 2) {
+    appendAck(MQTT_PUBREC, id);
+    flush();
+  }
+}
+
+// A PINGREQ goes out after half the keepalive without sending, as the broker
+// requires, and also without receiving, so that a client that only publishes
+// still gets a PINGRESP to prove the connection alive. While paused nothing is
+// read, so the time without receiving only counts from the resume.
+void MqttNetPosixClient::keepalive() {
+  if (keepAlive == 0) {
+    return;
+  }
+  uint64_t now = loop->now();
+  uint64_t half = keepAlive * 1000 / 2;
+  if (paused) {
+    lastReceived = now;
+  }
+  if (now - lastReceived > keepAlive * 1500) {
+    Serial.println("MqttNetPosixClient: keepalive timeout");
+    closeSocket(MqttNetDisconnectReason::TCP_DISCONNECTED);
+    return;
+  }
+  if (state == CONNECTED && !pingPending && (now - lastSent >= half || now - lastReceived >= half)) {
+    appendHeader(MQTT_PINGREQ, 0);
+    pingPending = true;
+    flush();
+  }
+}
+
+void MqttNetPosixClient::closeSocket(MqttNetDisconnectReason reason) {
+  keepaliveTimer.detach();
+  if (fd >= 0) {
+    loop->remove(fd);
+    close(fd);
+    fd = -1;
+  }
+  bool notify = state != DISCONNECTED;
+  state = DISCONNECTED;
+  wantWrite = false;
+  outbound.clear();
+  outboundOffset = 0;
+  if (notify && disconnectHandler) {
+    disconnectHandler(reason);
+  }
+}
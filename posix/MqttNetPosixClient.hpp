@@ -0,0 +1,105 @@
+#ifndef MQTTNETPOSIXCLIENT_HPP
+#define MQTTNETPOSIXCLIENT_HPP
+
+#include <string>
+#include <vector>
+
+#include "MqttNetEventLoop.hpp"
+
+#define MQTTNET_POSIX_KEEPALIVE 15
+#define MQTTNET_POSIX_MAX_OUTBOUND 16384
+#define MQTTNET_POSIX_MAX_PACKET 65536
+#define MQTTNET_POSIX_RX_CHUNK 512
+
+// Non-blocking MQTT 3.1.1 client on top of a POSIX socket registered with a
+// MqttNetEventLoop. Behaves like AsyncMqttClient: publish() and subscribe()
+// return 0 when the outbound buffer has no room, and incoming messages are
+// delivered from the loop thread, with payloads split into chunks of at most
+// MQTTNET_POSIX_RX_CHUNK bytes like AsyncMqttClient splits them per TCP
+// segment. pauseReceive() takes effect between two chunks.
+class MqttNetPosixClient : public MqttNetClient, public MqttNetEventHandler {
+ private:
+  enum State {
+    DISCONNECTED,
+    CONNECTING,
+    WAIT_CONNACK,
+    CONNECTED
+  };
+
+  MqttNetEventLoop *loop;
+  MqttNetPosixTimer keepaliveTimer;
+  MqttNetPosixTimer resumeTimer;
+  connect_handler_t connectHandler;
+  disconnect_handler_t disconnectHandler;
+  message_handler_t messageHandler;
+  subscribe_handler_t subscribeHandler;
+  std::string clientId;
+  std::string host;
+  uint16_t port = 1883;
+  bool secure = false;
+  std::string username;
+  std::string password;
+  std::string willTopic;
+  std::string willPayload;
+  uint8_t willQos = 0;
+  bool willRetain = false;
+  bool cleanSession = true;
+  uint16_t keepAlive = MQTTNET_POSIX_KEEPALIVE;
+  State state = DISCONNECTED;
+  int fd = -1;
+  bool wantRead = true;
+  bool wantWrite = false;
+  bool paused = false;
+  bool pingPending = false;
+  uint16_t nextPacketId = 1;
+  uint64_t lastSent = 0;
+  uint64_t lastReceived = 0;
+  std::vector<uint8_t> outbound;
+  size_t outboundOffset = 0;
+  std::vector<uint8_t> inbound;
+  size_t deliverOffset = 0;
+  std::vector<char> topicBuffer;
+
+  uint16_t packetId();
+  bool hasRoom(size_t len);
+  void appendHeader(uint8_t type, size_t remaining);
+  void appendUint16(uint16_t value);
+  void appendString(const char *str, size_t len);
+  void appendAck(uint8_t type, uint16_t id);
+  void sendConnect();
+  void flush();
+  void updateEvents();
+  void readAvailable();
+  bool parseInbound();
+  void resumeReceive();
+  bool handlePacket(uint8_t header, const uint8_t *data, size_t len);
+  void handlePublish(uint8_t header, const uint8_t *data, size_t len);
+  void keepalive();
+  void closeSocket(MqttNetDisconnectReason reason);
+
+ public:
+  explicit MqttNetPosixClient(MqttNetEventLoop *loop);
+  ~MqttNetPosixClient();
+  void onConnect(connect_handler_t handler);
+  void onDisconnect(disconnect_handler_t handler);
+  void onMessage(message_handler_t handler);
+  void onSubscribe(subscribe_handler_t handler);
+  void setClientId(const char *clientId);
+  void setServer(const char *host, uint16_t port);
+  void setSecure(bool secure);
+  void setCredentials(const char *username, const char *password);
+  void setWill(const char *topic, uint8_t qos, bool retain, const char *payload);
+  void setCleanSession(bool cleanSession);
+  void setKeepAlive(uint16_t seconds);
+  void connect();
+  void disconnect();
+  bool connected();
+  uint16_t subscribe(const char *topic, uint8_t qos);
+  size_t subscribe(const char *const *topics, const uint8_t *qos, size_t count, uint16_t *packetIds);
+  void pauseReceive(bool pause);
+  uint16_t unsubscribe(const char *topic);
+  uint16_t publish(const char *topic, uint8_t qos, bool retain, const char *payload, size_t length);
+  void onEvents(uint32_t events);
+};
+
+#endif
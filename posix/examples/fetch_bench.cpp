@@ -0,0 +1,160 @@
+// Measures sustained net/fetch/* download throughput against a local broker.
+//
+//   mqttnet_fetch_bench [host] [port] [size_kb] [window] [storage]
+//
+// Writes a random file of size_kb into the storage directory of a MqttNet
+// instance and fetches it with a second client on the same event loop,
+// granting window chunks of credit up front and topping them up as chunks
+// arrive. Prints the throughput and whether the MD5 trailer matched.
+
+#include <stdlib.h>
+#include <string>
+
+#include "MqttNet.hpp"
+#include "posix/MqttNetPosix.hpp"
+
+static const char *device_prefix = "bench/device";
+
+struct Fetcher {
+  MqttNetEventLoop *loop;
+  MqttNetPosixClient *client;
+  int window;
+  int outstanding = 0;
+  size_t received = 0;
+  size_t chunks = 0;
+  bool failed = false;
+  MD5Builder md5;
+  String expected_md5;
+  uint64_t started = 0;
+  uint64_t finished = 0;
+
+  void publish(const char *action, const String &value) {
+    std::string topic = std::string(device_prefix) + "/net/fetch/" + action;
+    client->publish(topic.c_str(), 0, false, value.c_str(), value.length());
+  }
+
+  void start() {
+    md5.begin();
+    started = loop->now();
+    publish("start", "bench.bin");
+    publish("credit", String(window));
+    outstanding = window;
+  }
+
+  void onMessage(char *topic, char *payload, size_t len, size_t index, size_t total) {
+    const char *action = strrchr(topic, '/') + 1;
+    if (strcmp(action, "data") == 0) {
+      // payloads arrive in chunks of the client, a fetch chunk is complete
+      // once index + len reaches total
+      if (index == 0) {
+        uint32_t offset = ((uint8_t)payload[0] << 24) | ((uint8_t)payload[1] << 16) | ((uint8_t)payload[2] << 8) | (uint8_t)payload[3];
+        if (offset != received) {
+          Serial.println("fetch_bench: unexpected offset");
+          failed = true;
+        }
+        payload += 4;
+        len -= 4;
+      }
+      md5.add((uint8_t *)payload, len);
+      received += len;
+      if (index + len + (index == 0 ? 4 : 0) < total) {
+        return;
+      }
+      chunks++;
+      if (--outstanding <= window / 2) {
+        publish("credit", String(window - outstanding));
+        outstanding = window;
+      }
+    } else if (strcmp(action, "md5") == 0) {
+      md5.calculate();
+      String remote(std::string(payload, len).c_str());
+      failed = failed || !remote.equals(md5.toString()) || !remote.equals(expected_md5);
+      finished = loop->now();
+      loop->stop();
+    } else if (strcmp(action, "state") == 0 && len >= 5 && strncmp(payload, "error", 5) == 0) {
+      Serial.println("fetch_bench: device reported an error");
+      failed = true;
+      loop->stop();
+    }
+  }
+};
+
+int main(int argc, char **argv) {
+  const char *host = argc > 1 ? argv[1] : "127.0.0.1";
+  uint16_t port = argc > 2 ? atoi(argv[2]) : 1883;
+  size_t size = (argc > 3 ? atol(argv[3]) : 1024) * 1024;
+  int window = argc > 4 ? atoi(argv[4]) : 16;
+  if (window > (int)MqttNetDefaultConfig::fetch_window) {
+    // the device ignores credit beyond its window
+    window = MqttNetDefaultConfig::fetch_window;
+  }
+  const char *storage = argc > 5 ? argv[5] : "/tmp/mqttnet-fetch-bench";
+
+  MqttNetEventLoop loop;
+  MqttNetPosix platform(loop, storage);
+
+  Fetcher fetcher;
+  fetcher.loop = &loop;
+  fetcher.window = window;
+
+  // test file
+  MD5Builder md5;
+  md5.begin();
+  int file = platform.storage().open("bench.bin", "w");
+  uint8_t block[1024];
+  srand(1);
+  for (size_t written = 0; written < size; written += sizeof(block)) {
+    size_t len = size - written < sizeof(block) ? size - written : sizeof(block);
+    for (size_t i = 0; i < len; i++) {
+      block[i] = rand();
+    }
+    platform.storage().write(file, block, len);
+    md5.add(block, len);
+  }
+  platform.storage().close(file);
+  md5.calculate();
+  fetcher.expected_md5 = md5.toString();
+
+  MqttNet device(platform);
+  device.allowRemoteFetch = true;
+  device.setClientId("fetch-bench-device");
+  device.setConfig(host, port, false, "", "", device_prefix);
+  device.begin();
+
+  MqttNetPosixClient client(&loop);
+  fetcher.client = &client;
+  client.setClientId("fetch-bench-client");
+  client.setServer(host, port);
+  client.onMessage([&fetcher](char *topic, char *payload, MqttNetMessageProperties properties, size_t len, size_t index, size_t total) {
+    (void)properties;
+    fetcher.onMessage(topic, payload, len, index, total);
+  });
+  client.onConnect([&client](bool sessionPresent) {
+    (void)sessionPresent;
+    client.subscribe((std::string(device_prefix) + "/net/fetch/+").c_str(), 0);
+  });
+  client.connect();
+
+  // start once the device had time to subscribe
+  MqttNetPosixTimer starter(&loop);
+  starter.attach_ms(250, [&]() {
+    if (device.isConnected() && client.connected() && millis() > 1000) {
+      starter.detach();
+      fetcher.start();
+    }
+  });
+  MqttNetPosixTimer timeout(&loop);
+  timeout.once_ms(120000, [&]() {
+    Serial.println("fetch_bench: timeout");
+    fetcher.failed = true;
+    loop.stop();
+  });
+  loop.run();
+
+  double seconds = (fetcher.finished - fetcher.started) / 1000.0;
+  printf("fetched %lu bytes in %lu chunks, window %d: %.3f s, %.1f KiB/s, md5 %s\n",
+      (unsigned long)fetcher.received, (unsigned long)fetcher.chunks, window, seconds,
+      seconds > 0 ? fetcher.received / 1024.0 / seconds : 0.0,
+      fetcher.failed || fetcher.received != size ? "MISMATCH" : "ok");
+  return fetcher.failed || fetcher.received != size ? 1 : 0;
+}
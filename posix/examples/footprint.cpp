@@ -0,0 +1,47 @@
+// Prints the static RAM of MqttNetT for the default configuration and with
+// each subsystem switched off in turn.
+//
+//   mqttnet_footprint
+//
+// The sizes are those of the host build; on a 32 bit target pointers and
+// size_t are smaller, so they are an upper bound for the ESP8266. To fail a
+// build above a size instead, set Config::ram_budget.
+
+#include <stdio.h>
+
+#include "MqttNet.hpp"
+
+struct NoSyncConfig : MqttNetDefaultConfig {
+  static const bool sync = false;
+};
+
+struct NoFetchConfig : MqttNetDefaultConfig {
+  static const bool fetch = false;
+};
+
+struct NoBatchConfig : MqttNetDefaultConfig {
+  static const bool batch = false;
+};
+
+struct NoStatsConfig : MqttNetDefaultConfig {
+  static const bool stats = false;
+};
+
+struct MinimalConfig : MqttNetDefaultConfig {
+  static const bool sync = false;
+  static const bool fetch = false;
+  static const bool batch = false;
+  static const bool firmware = false;
+  static const bool stats = false;
+  static const bool metadata = false;
+};
+
+int main() {
+  printf("%-16s %6lu bytes\n", "default", (unsigned long)sizeof(MqttNet));
+  printf("%-16s %6lu bytes\n", "sync = false", (unsigned long)sizeof(MqttNetT<NoSyncConfig>));
+  printf("%-16s %6lu bytes\n", "fetch = false", (unsigned long)sizeof(MqttNetT<NoFetchConfig>));
+  printf("%-16s %6lu bytes\n", "batch = false", (unsigned long)sizeof(MqttNetT<NoBatchConfig>));
+  printf("%-16s %6lu bytes\n", "stats = false", (unsigned long)sizeof(MqttNetT<NoStatsConfig>));
+  printf("%-16s %6lu bytes\n", "all off", (unsigned long)sizeof(MqttNetT<MinimalConfig>));
+  return 0;
+}
@@ -0,0 +1,96 @@
+// Simulates many MqttNet devices on a single thread.
+//
+//   mqttnet_gateway_sim [host] [port] [count] [prefix] [storage]
+//
+// Every instance connects with its own client id and uses the topic prefix
+// "<prefix>/<n>", so the usual net/ping, net/sync/* and net/restart topics
+// can be exercised against a local broker, e.g.
+//
+//   mosquitto_pub -t sim/17/net/ping -m hello
+//   mosquitto_sub -v -t 'sim/+/net/#'
+
+#include <memory>
+#include <signal.h>
+#include <stdlib.h>
+#include <sys/stat.h>
+#include <vector>
+
+#include "MqttNet.hpp"
+#include "posix/MqttNetPosix.hpp"
+
+struct SimDevice {
+  std::string clientId;
+  std::string prefix;
+  std::unique_ptr<MqttNetPosix> platform;
+  std::unique_ptr<MqttNet> net;
+};
+
+static MqttNetEventLoop loop;
+static unsigned long connects = 0;
+static unsigned long messages = 0;
+
+static void onConnect(bool sessionPresent) {
+  (void)sessionPresent;
+  connects++;
+}
+
+static void onString(const char *topic, const char *payload, bool retain) {
+  (void)topic;
+  (void)payload;
+  (void)retain;
+  messages++;
+}
+
+static void onSignal(int sig) {
+  (void)sig;
+  loop.stop();
+}
+
+int main(int argc, char **argv) {
+  const char *host = argc > 1 ? argv[1] : "127.0.0.1";
+  uint16_t port = argc > 2 ? atoi(argv[2]) : 1883;
+  int count = argc > 3 ? atoi(argv[3]) : 100;
+  std::string prefix = argc > 4 ? argv[4] : "sim";
+  std::string storage = argc > 5 ? argv[5] : "/tmp/mqttnet-sim";
+
+  signal(SIGINT, onSignal);
+  signal(SIGTERM, onSignal);
+  mkdir(storage.c_str(), 0755);
+
+  std::vector<SimDevice> devices(count);
+  for (int i = 0; i < count; i++) {
+    SimDevice &device = devices[i];
+    device.clientId = prefix + "-" + std::to_string(i);
+    device.prefix = prefix + "/" + std::to_string(i);
+    device.platform.reset(new MqttNetPosix(loop, (storage + "/" + std::to_string(i)).c_str()));
+    device.net.reset(new MqttNet(*device.platform));
+    device.net->allowRemoteSync = true;
+    device.net->connect_callback = onConnect;
+    device.net->string_callback = onString;
+    device.net->setClientId(device.clientId.c_str());
+    device.net->setConfig(host, port, false, "", "", device.prefix.c_str());
+    device.net->begin();
+  }
+
+  MqttNetPosixTimer report(&loop);
+  report.attach_ms(5000, [&devices]() {
+    int online = 0;
+    for (size_t i = 0; i < devices.size(); i++) {
+      if (devices[i].net->isConnected()) {
+        online++;
+        devices[i].net->publish("sim/uptime", 0, false, String(millis()));
+      }
+    }
+    Serial.print("gateway_sim: online=");
+    Serial.print(online, DEC);
+    Serial.print("/");
+    Serial.print((int)devices.size(), DEC);
+    Serial.print(" connects=");
+    Serial.print(connects, DEC);
+    Serial.print(" messages=");
+    Serial.println(messages, DEC);
+  });
+
+  loop.run();
+  return 0;
+}
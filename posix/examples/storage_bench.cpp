@@ -0,0 +1,125 @@
+// Measures FileWriter write and commit throughput per storage backend.
+//
+//   mqttnet_storage_bench [size_kb] [chunk] [capacity_kb] [directory]
+//
+// For every backend the storage is first filled to 0, 25, 50 and 75% of
+// capacity_kb with filler files, then a file of size_kb is written through
+// FileWriter in chunks of the given size and committed, five times per fill
+// level. Commit includes the MD5 verification pass over the temporary file
+// and the rename onto the target. The directory backend writes below the
+// given directory and treats capacity_kb as nominal, the memory backend
+// enforces it.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string>
+#include <vector>
+
+#include "FileWriter.hpp"
+#include "posix/MqttNetMemoryStorage.hpp"
+#include "posix/MqttNetPosix.hpp"
+
+static const char *target = "bench/storage/fill-level/output.bin";
+static const int rounds = 5;
+
+struct Result {
+  unsigned long write_us = 0;
+  unsigned long commit_us = 0;
+  bool ok = true;
+};
+
+static void fill(MqttNetStorage &storage, size_t bytes, std::vector<std::string> &fillers) {
+  static uint8_t block[4096];
+  for (size_t written = 0; written < bytes;) {
+    std::string name = "filler" + std::to_string(fillers.size());
+    int file = storage.open(name.c_str(), "w");
+    if (file < 0) {
+      break;
+    }
+    size_t file_size = bytes - written < 16 * sizeof(block) ? bytes - written : 16 * sizeof(block);
+    for (size_t done = 0; done < file_size; done += sizeof(block)) {
+      size_t len = file_size - done < sizeof(block) ? file_size - done : sizeof(block);
+      storage.write(file, block, len);
+    }
+    storage.close(file);
+    fillers.push_back(name);
+    written += file_size;
+  }
+}
+
+static Result run(MqttNetStorage &storage, const std::vector<uint8_t> &data, size_t chunk, const String &md5) {
+  Result result;
+  FileWriter writer(&storage);
+  for (int round = 0; round < rounds; round++) {
+    unsigned long started = micros();
+    result.ok = writer.Begin(target, md5.c_str(), data.size()) && writer.Open() && result.ok;
+    for (size_t pos = 0; pos < data.size() && result.ok; pos += chunk) {
+      size_t len = data.size() - pos < chunk ? data.size() - pos : chunk;
+      result.ok = writer.Add((uint8_t *)data.data() + pos, len);
+    }
+    unsigned long written = micros();
+    result.ok = result.ok && writer.Commit();
+    result.write_us += written - started;
+    result.commit_us += micros() - written;
+  }
+  return result;
+}
+
+static void bench(const char *name, MqttNetStorage &storage, size_t capacity, const std::vector<uint8_t> &data, size_t chunk, const String &md5, std::vector<std::string> &lines) {
+  for (int level = 0; level < 4; level++) {
+    std::vector<std::string> fillers;
+    fill(storage, capacity / 4 * level, fillers);
+    Result result = run(storage, data, chunk, md5);
+    for (size_t i = 0; i < fillers.size(); i++) {
+      storage.remove(fillers[i].c_str());
+    }
+    storage.remove(target);
+
+    char line[160];
+    double kib = data.size() * rounds / 1024.0;
+    snprintf(line, sizeof(line), "%-9s %3d%% %10.1f KiB/s %10.1f KiB/s  %s",
+        name, level * 25,
+        result.write_us ? kib / (result.write_us / 1e6) : 0.0,
+        result.commit_us ? kib / (result.commit_us / 1e6) : 0.0,
+        result.ok ? "ok" : "FAILED");
+    lines.push_back(line);
+  }
+}
+
+int main(int argc, char **argv) {
+  size_t size = (argc > 1 ? atol(argv[1]) : 64) * 1024;
+  size_t chunk = argc > 2 ? atol(argv[2]) : 256;
+  size_t capacity = (argc > 3 ? atol(argv[3]) : 1024) * 1024;
+  const char *directory = argc > 4 ? argv[4] : "/tmp/mqttnet-storage-bench";
+
+  std::vector<uint8_t> data(size);
+  srand(1);
+  for (size_t i = 0; i < size; i++) {
+    data[i] = rand();
+  }
+  MD5Builder md5;
+  md5.begin();
+  md5.add(data.data(), data.size());
+  md5.calculate();
+
+  std::vector<std::string> lines;
+  MqttNetPosixStorage posix(directory);
+  bench("directory", posix, capacity, data, chunk, md5.toString(), lines);
+  // the file being written and the committed one from the round before
+  // have to fit next to the filler files
+  MqttNetMemoryStorage memory(capacity + 2 * size);
+  bench("memory", memory, capacity, data, chunk, md5.toString(), lines);
+
+  printf("%lu KiB in %lu byte chunks, %d rounds per fill level of %lu KiB\n",
+      (unsigned long)size / 1024, (unsigned long)chunk, rounds, (unsigned long)capacity / 1024);
+  printf("backend   fill          write         commit\n");
+  for (size_t i = 0; i < lines.size(); i++) {
+    printf("%s\n", lines[i].c_str());
+  }
+  for (size_t i = 0; i < lines.size(); i++) {
+    if (lines[i].find("FAILED") != std::string::npos) {
+      return 1;
+    }
+  }
+  return 0;
+}
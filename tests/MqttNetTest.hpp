@@ -0,0 +1,59 @@
+#ifndef MQTTNETTEST_HPP
+#define MQTTNETTEST_HPP
+
+#include <stdio.h>
+
+#include <string>
+
+#include "MqttNetPlatform.hpp"
+
+// Minimal checks for the host tests: a failed check prints its location and
+// makes MQTTNET_TEST_RESULT() return 1, so that ctest reports the test.
+static int mqttnet_test_failures = 0;
+
+#define CHECK(cond) \
+  do { \
+    if (!(cond)) { \
+      printf("%s:%d: CHECK(%s) failed\n", __FILE__, __LINE__, #cond); \
+      mqttnet_test_failures++; \
+    } \
+  } while (0)
+
+#define CHECK_EQ(actual, expected) \
+  do { \
+    long long a_ = (long long)(actual); \
+    long long e_ = (long long)(expected); \
+    if (a_ != e_) { \
+      printf("%s:%d: CHECK_EQ(%s, %s) failed: %lld != %lld\n", __FILE__, __LINE__, #actual, #expected, a_, e_); \
+      mqttnet_test_failures++; \
+    } \
+  } while (0)
+
+// hex MD5 of data, as sent along with a file or bundle
+inline String md5Of(const uint8_t *data, size_t len) {
+  MD5Builder md5;
+  md5.begin();
+  md5.add(data, len);
+  md5.calculate();
+  return md5.toString();
+}
+
+// contents of a file in storage, empty if it does not exist
+inline std::string readFile(MqttNetStorage &storage, const char *path) {
+  std::string contents;
+  int handle = storage.open(path, "r");
+  if (handle < 0) {
+    return contents;
+  }
+  uint8_t buf[256];
+  size_t n;
+  while ((n = storage.read(handle, buf, sizeof(buf))) > 0) {
+    contents.append((const char *)buf, n);
+  }
+  storage.close(handle);
+  return contents;
+}
+
+#define MQTTNET_TEST_RESULT() (printf("%s\n", mqttnet_test_failures ? "FAILED" : "ok"), mqttnet_test_failures ? 1 : 0)
+
+#endif
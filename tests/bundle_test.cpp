@@ -0,0 +1,194 @@
+#include <vector>
+
+#include "BundleWriter.hpp"
+#include "MqttNetTest.hpp"
+#include "posix/MqttNetMemoryStorage.hpp"
+
+// refuses to rename anything onto the path in blocked
+class BlockingStorage : public MqttNetMemoryStorage {
+ public:
+  std::string blocked;
+  bool rename(const char *from, const char *to) {
+    return blocked != to && MqttNetMemoryStorage::rename(from, to);
+  }
+};
+
+static void addEntry(std::vector<uint8_t> &bundle, const char *name, const std::string &data, bool corrupt = false) {
+  bundle.insert(bundle.end(), name, name + strlen(name) + 1);
+  for (int i = 0; i < 4; i++) {
+    bundle.push_back(data.size() >> (24 - 8 * i));
+  }
+  MD5Builder md5;
+  md5.begin();
+  md5.add((const uint8_t *)data.data(), data.size());
+  md5.calculate();
+  uint8_t digest[16];
+  md5.getBytes(digest);
+  if (corrupt) {
+    digest[0] ^= 1;
+  }
+  bundle.insert(bundle.end(), digest, digest + 16);
+  bundle.insert(bundle.end(), data.begin(), data.end());
+}
+
+// feeds the bundle in pieces of step bytes, which end anywhere in headers
+// and data, and commits it
+static bool install(BundleWriter &writer, std::vector<uint8_t> bundle, size_t step, const char *md5 = nullptr) {
+  String sum = md5Of(bundle.data(), bundle.size());
+  if (!writer.Begin(md5 ? md5 : sum.c_str(), bundle.size())) {
+    return false;
+  }
+  for (size_t at = 0; at < bundle.size(); at += step) {
+    size_t len = bundle.size() - at < step ? bundle.size() - at : step;
+    if (!writer.Add(bundle.data() + at, len)) {
+      return false;
+    }
+  }
+  return writer.Commit();
+}
+
+static void testInstall() {
+  std::string large(1000, 'x');
+  for (size_t step : {1, 3, 7, 21, 64, 5000}) {
+    MqttNetMemoryStorage storage;
+    BundleWriter writer(&storage);
+    int staged = 0, committed = 0;
+    writer.onEntry([&](const char *name, const char *state) {
+      (void)name;
+      staged += strcmp(state, "staged") == 0;
+      committed += strcmp(state, "committed") == 0;
+    });
+    std::vector<uint8_t> bundle;
+    addEntry(bundle, "a.txt", "alpha");
+    addEntry(bundle, "dir/b.bin", large);
+    addEntry(bundle, "empty", "");
+    CHECK(install(writer, bundle, step));
+    CHECK_EQ(staged, 3);
+    CHECK_EQ(committed, 3);
+    CHECK(readFile(storage, "a.txt") == "alpha");
+    CHECK(readFile(storage, "dir/b.bin") == large);
+    CHECK(storage.exists("empty"));
+    CHECK(!storage.exists("bundle.0"));
+    CHECK(!storage.exists("bundle.lst"));
+    CHECK(!storage.exists("bundle.cmt"));
+
+    // the same bundle again only has unchanged entries
+    int unchanged = 0;
+    writer.onEntry([&](const char *name, const char *state) {
+      (void)name;
+      unchanged += strcmp(state, "unchanged") == 0;
+    });
+    CHECK(install(writer, bundle, step));
+    CHECK_EQ(unchanged, 3);
+  }
+}
+
+static void testFailures() {
+  MqttNetMemoryStorage storage;
+  BundleWriter writer(&storage);
+  std::vector<uint8_t> bundle;
+  addEntry(bundle, "a.txt", "alpha");
+  addEntry(bundle, "b.txt", "beta", true);
+  CHECK(!install(writer, bundle, 4));
+  CHECK(strcmp(writer.GetError(), "entry md5 mismatch") == 0);
+  CHECK(!writer.Running());
+  CHECK(!storage.exists("a.txt"));
+  CHECK(!storage.exists("bundle.0"));
+  CHECK(!storage.exists("bundle.lst"));
+
+  bundle.clear();
+  addEntry(bundle, "bundle.lst", "x");
+  CHECK(!install(writer, bundle, 4));
+  CHECK(strcmp(writer.GetError(), "invalid name") == 0);
+
+  bundle.clear();
+  addEntry(bundle, "a.txt", "alpha");
+  CHECK(!install(writer, bundle, 4, "00000000000000000000000000000000"));
+  CHECK(strcmp(writer.GetError(), "bundle md5 mismatch") == 0);
+  CHECK(!storage.exists("a.txt"));
+  CHECK(!storage.exists("bundle.0"));
+
+  // a bundle cut short
+  String sum = md5Of(bundle.data(), bundle.size());
+  CHECK(writer.Begin(sum.c_str(), bundle.size()));
+  CHECK(writer.Add(bundle.data(), bundle.size() - 1));
+  CHECK(!writer.Commit());
+  CHECK(strcmp(writer.GetError(), "truncated bundle") == 0);
+
+  std::vector<uint8_t> empty_name(21, 0);
+  CHECK(!install(writer, empty_name, 4));
+  CHECK(strcmp(writer.GetError(), "bad entry header") == 0);
+  CHECK_EQ(storage.used(), 0);
+}
+
+// a commit interrupted after bundle.cmt was written is completed on the
+// next start, a bundle without it is dropped
+static void testRecover() {
+  MqttNetMemoryStorage storage;
+  BundleWriter writer(&storage);
+  int handle = storage.open("bundle.0", "w");
+  storage.write(handle, (const uint8_t *)"staged", 6);
+  storage.close(handle);
+  handle = storage.open("bundle.cmt", "w");
+  storage.write(handle, (const uint8_t *)"c.txt\n", 6);
+  storage.close(handle);
+  CHECK(writer.Recover());
+  CHECK(readFile(storage, "c.txt") == "staged");
+  CHECK(!storage.exists("bundle.cmt"));
+
+  handle = storage.open("bundle.0", "w");
+  storage.close(handle);
+  handle = storage.open("bundle.lst", "w");
+  storage.write(handle, (const uint8_t *)"d.txt\n", 6);
+  storage.close(handle);
+  CHECK(!writer.Recover());
+  CHECK(!storage.exists("bundle.0"));
+  CHECK(!storage.exists("bundle.lst"));
+  CHECK(!storage.exists("d.txt"));
+}
+
+// an entry that cannot be moved into place fails the commit and is tried
+// once more by the next Recover(), then dropped
+static void testInstallFailure() {
+  BlockingStorage storage;
+  BundleWriter writer(&storage);
+  std::vector<std::string> errors;
+  writer.onEntry([&](const char *name, const char *state) {
+    if (strncmp(state, "error", 5) == 0) {
+      errors.push_back(name);
+    }
+  });
+  std::vector<uint8_t> bundle;
+  addEntry(bundle, "a.txt", "alpha");
+  addEntry(bundle, "b.txt", "beta");
+  storage.blocked = "b.txt";
+  CHECK(!install(writer, bundle, 64));
+  CHECK(strcmp(writer.GetError(), "install failed") == 0);
+  CHECK(errors.size() == 1 && errors[0] == "b.txt");
+  CHECK(readFile(storage, "a.txt") == "alpha");
+  CHECK(storage.exists("bundle.cmt"));
+  CHECK(storage.exists("bundle.1"));
+
+  storage.blocked = "";
+  CHECK(writer.Recover());
+  CHECK(readFile(storage, "b.txt") == "beta");
+  CHECK(!storage.exists("bundle.cmt"));
+  CHECK(!storage.exists("bundle.1"));
+
+  storage.remove("b.txt");
+  storage.blocked = "b.txt";
+  CHECK(!install(writer, bundle, 64));
+  CHECK(!writer.Recover());
+  CHECK(strcmp(writer.GetError(), "install failed") == 0);
+  CHECK(!storage.exists("bundle.cmt"));
+  CHECK(!storage.exists("bundle.0"));
+  CHECK(!storage.exists("b.txt"));
+}
+
+int main() {
+  testInstall();
+  testFailures();
+  testRecover();
+  testInstallFailure();
+  return MQTTNET_TEST_RESULT();
+}
@@ -0,0 +1,59 @@
+#include <vector>
+
+#include "MqttNetCbor.hpp"
+#include "MqttNetTest.hpp"
+
+static bool encodes(MqttNetCborWriter &writer, const uint8_t *buffer, std::vector<uint8_t> expected) {
+  bool match = writer.size() == expected.size() && memcmp(buffer, expected.data(), expected.size()) == 0;
+  writer.truncate(0);
+  return match;
+}
+
+// examples from RFC 8949 appendix A
+static void testEncodings() {
+  uint8_t buffer[32];
+  MqttNetCborWriter writer(buffer, sizeof(buffer));
+  CHECK(writer.writeUnsigned(0) && encodes(writer, buffer, {0x00}));
+  CHECK(writer.writeUnsigned(23) && encodes(writer, buffer, {0x17}));
+  CHECK(writer.writeUnsigned(24) && encodes(writer, buffer, {0x18, 0x18}));
+  CHECK(writer.writeUnsigned(1000) && encodes(writer, buffer, {0x19, 0x03, 0xe8}));
+  CHECK(writer.writeUnsigned(1000000) && encodes(writer, buffer, {0x1a, 0x00, 0x0f, 0x42, 0x40}));
+  CHECK(writer.writeUnsigned(1000000000000ULL) &&
+        encodes(writer, buffer, {0x1b, 0x00, 0x00, 0x00, 0xe8, 0xd4, 0xa5, 0x10, 0x00}));
+  CHECK(writer.writeInteger(-1) && encodes(writer, buffer, {0x20}));
+  CHECK(writer.writeInteger(-100) && encodes(writer, buffer, {0x38, 0x63}));
+  CHECK(writer.writeInteger(-1000) && encodes(writer, buffer, {0x39, 0x03, 0xe7}));
+  CHECK(writer.writeBool(false) && encodes(writer, buffer, {0xf4}));
+  CHECK(writer.writeBool(true) && encodes(writer, buffer, {0xf5}));
+  CHECK(writer.writeText("IETF", 4) && encodes(writer, buffer, {0x64, 0x49, 0x45, 0x54, 0x46}));
+  CHECK(writer.writeText("", 0) && encodes(writer, buffer, {0x60}));
+  CHECK(writer.writeNumber(1.5) && encodes(writer, buffer, {0xfa, 0x3f, 0xc0, 0x00, 0x00}));
+  CHECK(writer.writeNumber(100000.0) && encodes(writer, buffer, {0x1a, 0x00, 0x01, 0x86, 0xa0}));
+  CHECK(writer.writeNumber(-4.0) && encodes(writer, buffer, {0x23}));
+  CHECK(writer.writeNumber(1.1) && encodes(writer, buffer, {0xfb, 0x3f, 0xf1, 0x99, 0x99, 0x99, 0x99, 0x99, 0x9a}));
+  CHECK(writer.beginIndefiniteMap() && writer.writeText("a", 1) && writer.writeUnsigned(1) && writer.endIndefinite() &&
+        encodes(writer, buffer, {0xbf, 0x61, 0x61, 0x01, 0xff}));
+}
+
+// a write that does not fit leaves the buffer as it was
+static void testCapacity() {
+  uint8_t buffer[4];
+  MqttNetCborWriter writer(buffer, sizeof(buffer));
+  CHECK(writer.writeUnsigned(1000));
+  CHECK(!writer.writeUnsigned(1000));
+  CHECK(!writer.writeText("ab", 2));
+  CHECK(writer.writeBool(true));
+  CHECK_EQ(writer.size(), 4);
+  CHECK(!writer.endIndefinite());
+  CHECK(!writer.writeNumber(1.5));
+  CHECK_EQ(writer.size(), 4);
+  writer.truncate(3);
+  CHECK(writer.writeUnsigned(7));
+  CHECK_EQ(buffer[3], 0x07);
+}
+
+int main() {
+  testEncodings();
+  testCapacity();
+  return MQTTNET_TEST_RESULT();
+}
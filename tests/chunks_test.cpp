@@ -0,0 +1,174 @@
+#include <vector>
+
+#include "MqttNetChunks.hpp"
+#include "MqttNetTest.hpp"
+
+typedef MqttNetChunkReceiver<64, 4> Receiver;
+
+// a sync chunk as a sender builds it: offset, CRC32, data
+static std::vector<uint8_t> chunk(uint32_t offset, size_t length, uint8_t fill = 0x5a) {
+  std::vector<uint8_t> message(8 + length, fill);
+  for (int i = 0; i < 4; i++) {
+    message[i] = offset >> (24 - 8 * i);
+  }
+  uint32_t crc = mqttnet_crc32(message.data(), 4);
+  crc = mqttnet_crc32(message.data() + 8, length, crc);
+  for (int i = 0; i < 4; i++) {
+    message[4 + i] = crc >> (24 - 8 * i);
+  }
+  return message;
+}
+
+static MqttNetChunkResult collect(Receiver &receiver, const std::vector<uint8_t> &message) {
+  return receiver.collect(message.data(), message.size(), 0, message.size());
+}
+
+// collects, places and, if accepted, commits a chunk like onSyncChunk()
+static MqttNetChunkPlacement deliver(Receiver &receiver, uint32_t offset, size_t length, uint32_t *retry_offset = nullptr,
+                                     uint32_t *retry_length = nullptr) {
+  uint32_t o = 0, l = 0;
+  CHECK_EQ(collect(receiver, chunk(offset, length)), MQTTNET_CHUNK_COMPLETE);
+  MqttNetChunkPlacement placement = receiver.place(true, &o, &l);
+  if (placement == MQTTNET_CHUNK_ACCEPT || placement == MQTTNET_CHUNK_GAP) {
+    receiver.commit();
+  }
+  if (retry_offset) {
+    *retry_offset = o;
+    *retry_length = l;
+  }
+  return placement;
+}
+
+static void testCollect() {
+  Receiver receiver;
+  std::vector<uint8_t> message = chunk(100, 20);
+  CHECK_EQ(collect(receiver, message), MQTTNET_CHUNK_COMPLETE);
+  CHECK_EQ(receiver.offset(), 100);
+  CHECK_EQ(receiver.length(), 20);
+
+  // in pieces, split inside the header
+  CHECK_EQ(receiver.collect(message.data(), 3, 0, message.size()), MQTTNET_CHUNK_PARTIAL);
+  CHECK_EQ(receiver.collect(message.data() + 3, 10, 3, message.size()), MQTTNET_CHUNK_PARTIAL);
+  CHECK_EQ(receiver.collect(message.data() + 13, message.size() - 13, 13, message.size()), MQTTNET_CHUNK_COMPLETE);
+
+  // a corrupted byte, a lost piece after the header and a lost header
+  message[20] ^= 1;
+  CHECK_EQ(collect(receiver, message), MQTTNET_CHUNK_BAD_CRC);
+  CHECK_EQ(receiver.collect(message.data(), 12, 0, message.size()), MQTTNET_CHUNK_PARTIAL);
+  CHECK_EQ(receiver.collect(message.data() + 20, message.size() - 20, 20, message.size()), MQTTNET_CHUNK_BAD_CRC);
+  CHECK_EQ(receiver.collect(message.data() + 20, message.size() - 20, 20, message.size()), MQTTNET_CHUNK_NO_HEADER);
+
+  // shorter than a header, longer than the buffer, or out of its range
+  CHECK_EQ(receiver.collect(message.data(), 7, 0, 7), MQTTNET_CHUNK_MALFORMED);
+  std::vector<uint8_t> large = chunk(0, 65);
+  CHECK_EQ(collect(receiver, large), MQTTNET_CHUNK_MALFORMED);
+  CHECK_EQ(receiver.collect(message.data(), 10, 20, 28), MQTTNET_CHUNK_MALFORMED);
+}
+
+static void testWithin() {
+  Receiver receiver;
+  CHECK_EQ(collect(receiver, chunk(90, 10)), MQTTNET_CHUNK_COMPLETE);
+  CHECK(receiver.within(100));
+  CHECK(!receiver.within(99));
+  CHECK_EQ(collect(receiver, chunk(0, 0)), MQTTNET_CHUNK_COMPLETE);
+  CHECK(receiver.within(0));
+  // offset + length would wrap around to 16 in 32 bits
+  CHECK_EQ(collect(receiver, chunk(0xfffffff0, 32)), MQTTNET_CHUNK_COMPLETE);
+  CHECK(!receiver.within(100));
+  CHECK(!receiver.within(0xfffffff8));
+}
+
+static void testSequential() {
+  Receiver receiver;
+  uint32_t offset = 0, length = 0;
+  CHECK_EQ(collect(receiver, chunk(0, 32)), MQTTNET_CHUNK_COMPLETE);
+  CHECK_EQ(receiver.place(false, &offset, &length), MQTTNET_CHUNK_ACCEPT);
+  receiver.commit();
+  CHECK_EQ(collect(receiver, chunk(64, 32)), MQTTNET_CHUNK_COMPLETE);
+  CHECK_EQ(receiver.place(false, &offset, &length), MQTTNET_CHUNK_REJECT);
+  CHECK_EQ(offset, 32);
+  CHECK_EQ(length, 64);
+  CHECK_EQ(collect(receiver, chunk(0, 32)), MQTTNET_CHUNK_COMPLETE);
+  CHECK_EQ(receiver.place(false, &offset, &length), MQTTNET_CHUNK_DUPLICATE);
+}
+
+static void testHoles() {
+  Receiver receiver;
+  uint32_t offset = 0, length = 0;
+  CHECK_EQ(deliver(receiver, 0, 10), MQTTNET_CHUNK_ACCEPT);
+  CHECK_EQ(deliver(receiver, 20, 10, &offset, &length), MQTTNET_CHUNK_GAP);
+  CHECK_EQ(offset, 10);
+  CHECK_EQ(length, 10);
+  CHECK(receiver.missing(&offset, &length));
+  CHECK_EQ(offset, 10);
+
+  // overlapping the hole and the data after it is a duplicate
+  CHECK_EQ(deliver(receiver, 15, 10), MQTTNET_CHUNK_DUPLICATE);
+  // filling the hole from its middle leaves a hole on either side
+  CHECK_EQ(deliver(receiver, 13, 4), MQTTNET_CHUNK_ACCEPT);
+  CHECK(receiver.missing(&offset, &length));
+  CHECK_EQ(offset, 10);
+  CHECK_EQ(length, 3);
+  CHECK_EQ(deliver(receiver, 10, 3), MQTTNET_CHUNK_ACCEPT);
+  CHECK(receiver.missing(&offset, &length));
+  CHECK_EQ(offset, 17);
+  CHECK_EQ(length, 3);
+  CHECK_EQ(deliver(receiver, 17, 3), MQTTNET_CHUNK_ACCEPT);
+  CHECK(!receiver.missing(&offset, &length));
+  CHECK_EQ(deliver(receiver, 13, 4), MQTTNET_CHUNK_DUPLICATE);
+
+  // a placed chunk that was not written leaves everything unchanged
+  CHECK_EQ(collect(receiver, chunk(40, 10)), MQTTNET_CHUNK_COMPLETE);
+  CHECK_EQ(receiver.place(true, &offset, &length), MQTTNET_CHUNK_GAP);
+  CHECK(!receiver.missing(&offset, &length));
+  receiver.expected(&offset, &length);
+  CHECK_EQ(offset, 30);
+}
+
+static void testFullHoleTable() {
+  Receiver receiver;
+  uint32_t offset = 0, length = 0;
+  // every other chunk of 10 bytes, until all 4 holes are used
+  for (uint32_t at = 0; at < 90; at += 20) {
+    CHECK(deliver(receiver, at, 10) != MQTTNET_CHUNK_REJECT);
+  }
+  // no room for another hole at the end
+  CHECK_EQ(deliver(receiver, 110, 10, &offset, &length), MQTTNET_CHUNK_REJECT);
+  CHECK_EQ(offset, 90);
+  CHECK_EQ(length, 30);
+}
+
+// A chunk inside a hole, with the table full, asks for the range from the
+// start of the hole. A sender that resends exactly what is asked for then
+// fills every hole instead of getting the same chunk rejected forever.
+static void testInsideHoleWithFullTable() {
+  Receiver receiver;
+  uint32_t offset = 0, length = 0;
+  for (uint32_t at = 0; at <= 120; at += 30) {
+    CHECK_EQ(deliver(receiver, at, 10), at == 0 ? MQTTNET_CHUNK_ACCEPT : MQTTNET_CHUNK_GAP);
+  }
+  CHECK_EQ(deliver(receiver, 15, 5, &offset, &length), MQTTNET_CHUNK_REJECT);
+  CHECK_EQ(offset, 10);
+  CHECK_EQ(length, 10);
+
+  int steps = 0;
+  for (; steps < 50; steps++) {
+    MqttNetChunkPlacement placement = deliver(receiver, offset, length > 10 ? 10 : length, &offset, &length);
+    if (placement != MQTTNET_CHUNK_REJECT && !receiver.missing(&offset, &length)) {
+      break;
+    }
+  }
+  CHECK(steps < 50);
+  CHECK(!receiver.missing(&offset, &length));
+  CHECK_EQ(deliver(receiver, 130, 10), MQTTNET_CHUNK_ACCEPT);
+}
+
+int main() {
+  testCollect();
+  testWithin();
+  testSequential();
+  testHoles();
+  testFullHoleTable();
+  testInsideHoleWithFullTable();
+  return MQTTNET_TEST_RESULT();
+}
@@ -0,0 +1,25 @@
+#include "MqttNet.hpp"
+#include "MqttNetTest.hpp"
+#include "posix/MqttNetPosix.hpp"
+
+// The example configuration of the README, so that a change to the defaults
+// or the static_asserts that breaks it fails here rather than in a sketch.
+struct SensorConfig : MqttNetDefaultConfig {
+  static const size_t publish_queue = 8;    // messages
+  static const size_t publish_pool = 768;   // bytes, shared by all queued messages
+  static const size_t inbound_pool = 1024;
+  static const size_t inbound_chunk = 128;
+  static const size_t max_payload = 128;
+  static const size_t batch_size = 128;     // one CBOR map, at most max_payload
+  static const bool sync = false;           // no net/sync/*, no FileWriter
+  static const bool firmware = false;
+  static const size_t ram_budget = 3584;    // static_assert on sizeof(MqttNetT<SensorConfig>)
+};
+
+int main() {
+  MqttNetEventLoop loop;
+  MqttNetPosix platform(loop, ".");
+  MqttNetT<SensorConfig> sensor(platform);
+  CHECK(sizeof(sensor) <= SensorConfig::ram_budget);
+  return MQTTNET_TEST_RESULT();
+}
@@ -0,0 +1,109 @@
+#include "FileWriter.hpp"
+#include "MqttNetTest.hpp"
+#include "posix/MqttNetMemoryStorage.hpp"
+
+static const std::string contents = "The quick brown fox jumps over the lazy dog";
+
+static String md5(const std::string &data) {
+  return md5Of((const uint8_t *)data.data(), data.size());
+}
+
+static void testSequential() {
+  MqttNetMemoryStorage storage;
+  FileWriter writer(&storage);
+  CHECK(writer.Begin("dir/fox.txt", md5(contents).c_str(), contents.size()));
+  CHECK(!writer.UpToDate());
+  CHECK(writer.Open());
+  CHECK(writer.Running());
+  for (size_t at = 0; at < contents.size(); at += 10) {
+    std::string piece = contents.substr(at, 10);
+    CHECK(writer.Add((uint8_t *)&piece[0], piece.size()));
+  }
+  CHECK_EQ(writer.GetPosition(), contents.size());
+  CHECK(writer.Commit());
+  CHECK(!writer.Running());
+  CHECK(readFile(storage, "dir/fox.txt") == contents);
+  CHECK(!storage.exists("tmp"));
+
+  CHECK(writer.Begin("dir/fox.txt", md5(contents).c_str(), contents.size()));
+  CHECK(writer.UpToDate());
+  writer.Abort();
+}
+
+// chunks written out of order, the gap before a chunk is filled with zeros
+static void testPositional() {
+  MqttNetMemoryStorage storage;
+  FileWriter writer(&storage);
+  CHECK(writer.Begin("fox.txt", md5(contents).c_str(), contents.size()));
+  CHECK(writer.Open());
+  std::string data = contents;
+  CHECK(writer.Add((uint8_t *)&data[30], data.size() - 30, 30));
+  CHECK_EQ(readFile(storage, "tmp").size(), contents.size());
+  CHECK(writer.Add((uint8_t *)&data[0], 10, 0));
+  CHECK(writer.Add((uint8_t *)&data[10], 20, 10));
+  CHECK(writer.Commit());
+  CHECK(readFile(storage, "fox.txt") == contents);
+}
+
+static void testFailures() {
+  MqttNetMemoryStorage storage;
+  FileWriter writer(&storage);
+  std::string data = contents;
+
+  // the MD5 does not match what was written
+  CHECK(writer.Begin("fox.txt", md5("other").c_str(), contents.size()));
+  CHECK(writer.Open());
+  CHECK(writer.Add((uint8_t *)&data[0], data.size()));
+  CHECK(!writer.Commit());
+  CHECK(!writer.Running());
+  CHECK(!storage.exists("fox.txt"));
+  CHECK(!storage.exists("tmp"));
+
+  // nothing can be added before Open()
+  CHECK(writer.Begin("fox.txt", md5(contents).c_str(), contents.size()));
+  CHECK(!writer.Add((uint8_t *)&data[0], data.size()));
+  writer.Abort();
+
+  char name[MQTTNET_FILENAME_MAX + 1];
+  memset(name, 'n', sizeof(name) - 1);
+  name[sizeof(name) - 1] = 0;
+  CHECK(!writer.Begin(name, md5(contents).c_str(), contents.size()));
+
+  // the storage fills up, the previous file stays
+  MqttNetMemoryStorage small(contents.size() + 10);
+  FileWriter limited(&small);
+  CHECK(limited.Begin("fox.txt", md5(contents).c_str(), contents.size()));
+  CHECK(limited.Open());
+  CHECK(limited.Add((uint8_t *)&data[0], data.size()));
+  CHECK(limited.Commit());
+  std::string longer = contents + contents;
+  CHECK(limited.Begin("fox.txt", md5(longer).c_str(), longer.size()));
+  CHECK(limited.Open());
+  CHECK(!limited.Add((uint8_t *)&longer[0], longer.size()));
+  limited.Abort();
+  CHECK(readFile(small, "fox.txt") == contents);
+  CHECK(!small.exists("tmp"));
+}
+
+// a file staged under another name and moved into place later
+static void testStage() {
+  MqttNetMemoryStorage storage;
+  FileWriter writer(&storage);
+  std::string data = contents;
+  CHECK(writer.Begin("fox.txt", md5(contents).c_str(), contents.size()));
+  CHECK(writer.Open());
+  CHECK(writer.Add((uint8_t *)&data[0], data.size()));
+  CHECK(writer.Stage("staged"));
+  CHECK(!storage.exists("fox.txt"));
+  CHECK(writer.Replace("staged", "sub/fox.txt"));
+  CHECK(readFile(storage, "sub/fox.txt") == contents);
+  CHECK(!storage.exists("staged"));
+}
+
+int main() {
+  testSequential();
+  testPositional();
+  testFailures();
+  testStage();
+  return MQTTNET_TEST_RESULT();
+}
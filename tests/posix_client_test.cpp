@@ -0,0 +1,289 @@
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <vector>
+
+#include "MqttNetTest.hpp"
+#include "posix/MqttNetPosixClient.hpp"
+
+// The client under test talks to a socket served by the test itself, which
+// plays the broker by writing raw packets in arbitrary pieces.
+class Broker {
+ public:
+  MqttNetEventLoop loop;
+  MqttNetPosixClient client;
+  int listener = -1;
+  int fd = -1;
+  struct Message {
+    std::string topic;
+    std::string payload;
+    size_t index;
+    size_t total;
+    uint8_t qos;
+  };
+  std::vector<Message> messages;
+  int disconnects = 0;
+
+  Broker() : client(&loop) {
+    listener = socket(AF_INET, SOCK_STREAM, 0);
+    struct sockaddr_in addr = {};
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    socklen_t len = sizeof(addr);
+    bind(listener, (struct sockaddr *)&addr, sizeof(addr));
+    listen(listener, 1);
+    getsockname(listener, (struct sockaddr *)&addr, &len);
+    client.setServer("127.0.0.1", ntohs(addr.sin_port));
+    client.onMessage([this](char *topic, char *payload, MqttNetMessageProperties properties, size_t len, size_t index,
+                            size_t total) {
+      messages.push_back({topic, std::string(payload, len), index, total, properties.qos});
+    });
+    client.onDisconnect([this](MqttNetDisconnectReason) { disconnects++; });
+  }
+
+  ~Broker() {
+    if (fd >= 0) {
+      close(fd);
+    }
+    close(listener);
+  }
+
+  void pump() {
+    for (int i = 0; i < 5; i++) {
+      loop.runOnce(5);
+    }
+  }
+
+  void send(std::vector<uint8_t> data) {
+    ::send(fd, data.data(), data.size(), MSG_NOSIGNAL);
+    pump();
+  }
+
+  // everything the client sent so far
+  std::vector<uint8_t> receive() {
+    pump();
+    std::vector<uint8_t> data;
+    uint8_t buf[1024];
+    ssize_t n;
+    while ((n = recv(fd, buf, sizeof(buf), MSG_DONTWAIT)) > 0) {
+      data.insert(data.end(), buf, buf + n);
+    }
+    return data;
+  }
+
+  bool connect() {
+    client.connect();
+    fd = accept(listener, NULL, NULL);
+    std::vector<uint8_t> packet = receive();
+    if (packet.empty() || packet[0] != 0x10) {
+      return false;
+    }
+    // CONNACK split after its first byte
+    send({0x20});
+    send({0x02, 0x00, 0x00});
+    return client.connected();
+  }
+};
+
+static std::vector<uint8_t> publishPacket(const char *topic, const std::string &payload, uint8_t qos, uint16_t id) {
+  size_t remaining = 2 + strlen(topic) + (qos ? 2 : 0) + payload.size();
+  std::vector<uint8_t> packet;
+  packet.push_back(0x30 | (qos << 1));
+  do {
+    uint8_t digit = remaining % 128;
+    remaining /= 128;
+    packet.push_back(digit | (remaining ? 0x80 : 0));
+  } while (remaining);
+  packet.push_back(strlen(topic) >> 8);
+  packet.push_back(strlen(topic) & 0xff);
+  packet.insert(packet.end(), topic, topic + strlen(topic));
+  if (qos) {
+    packet.push_back(id >> 8);
+    packet.push_back(id & 0xff);
+  }
+  packet.insert(packet.end(), payload.begin(), payload.end());
+  return packet;
+}
+
+// a publish with a two byte remaining length, written in pieces that split
+// the fixed header, and delivered in chunks of MQTTNET_POSIX_RX_CHUNK
+static void testSplitPublish() {
+  Broker broker;
+  CHECK(broker.connect());
+  std::string payload(600, 0);
+  for (size_t i = 0; i < payload.size(); i++) {
+    payload[i] = 'a' + i % 26;
+  }
+  std::vector<uint8_t> packet = publishPacket("net/sync/chunk", payload, 1, 0x1234);
+  size_t cuts[] = {1, 2, 3, 20, 300, packet.size()};
+  size_t from = 0;
+  for (size_t cut : cuts) {
+    broker.send(std::vector<uint8_t>(packet.begin() + from, packet.begin() + cut));
+    from = cut;
+  }
+  CHECK_EQ(broker.messages.size(), 2);
+  if (broker.messages.size() == 2) {
+    CHECK(broker.messages[0].topic == "net/sync/chunk");
+    CHECK_EQ(broker.messages[0].index, 0);
+    CHECK_EQ(broker.messages[0].payload.size(), MQTTNET_POSIX_RX_CHUNK);
+    CHECK_EQ(broker.messages[1].index, MQTTNET_POSIX_RX_CHUNK);
+    CHECK_EQ(broker.messages[1].total, 600);
+    CHECK_EQ(broker.messages[1].qos, 1);
+    CHECK(broker.messages[0].payload + broker.messages[1].payload == payload);
+  }
+  std::vector<uint8_t> ack = broker.receive();
+  CHECK(ack == std::vector<uint8_t>({0x40, 0x02, 0x12, 0x34}));
+}
+
+// several packets arriving in one segment
+static void testPacketsInOneSegment() {
+  Broker broker;
+  CHECK(broker.connect());
+  std::vector<uint8_t> data = publishPacket("a", "1", 0, 0);
+  std::vector<uint8_t> second = publishPacket("b", "", 2, 7);
+  data.push_back(0xd0);
+  data.push_back(0x00);
+  data.insert(data.end(), second.begin(), second.end());
+  broker.send(data);
+  CHECK_EQ(broker.messages.size(), 2);
+  if (broker.messages.size() == 2) {
+    CHECK(broker.messages[0].topic == "a" && broker.messages[0].payload == "1");
+    CHECK(broker.messages[1].topic == "b" && broker.messages[1].total == 0);
+  }
+  CHECK(broker.receive() == std::vector<uint8_t>({0x50, 0x02, 0x00, 0x07}));
+  CHECK_EQ(broker.disconnects, 0);
+}
+
+// a paused client delivers the rest of a message once resumed
+static void testPause() {
+  Broker broker;
+  CHECK(broker.connect());
+  broker.client.onMessage([&broker](char *, char *payload, MqttNetMessageProperties, size_t len, size_t index,
+                                    size_t total) {
+    broker.messages.push_back({"", std::string(payload, len), index, total, 0});
+    broker.client.pauseReceive(true);
+  });
+  broker.send(publishPacket("t", std::string(1100, 'x'), 0, 0));
+  CHECK_EQ(broker.messages.size(), 1);
+  broker.client.pauseReceive(false);
+  broker.pump();
+  CHECK_EQ(broker.messages.size(), 2);
+  broker.client.pauseReceive(false);
+  broker.pump();
+  CHECK_EQ(broker.messages.size(), 3);
+  CHECK_EQ(broker.messages.back().index, 1024);
+}
+
+static void testSubscribe() {
+  Broker broker;
+  CHECK(broker.connect());
+  uint16_t id = broker.client.subscribe("net/#", 1);
+  CHECK(id != 0);
+  std::vector<uint8_t> packet = broker.receive();
+  CHECK_EQ(packet.size(), 2 + 2 + 2 + 5 + 1);
+  if (packet.size() >= 4) {
+    CHECK_EQ(packet[0], 0x82);
+    CHECK_EQ((packet[2] << 8) | packet[3], id);
+  }
+
+  // every filter of a SUBSCRIBE gets its packet id, the SUBACK reports one
+  // code per filter
+  const char *topics[] = {"a", "b"};
+  const uint8_t qos[] = {0, 1};
+  uint16_t ids[2] = {0, 0};
+  CHECK_EQ(broker.client.subscribe(topics, qos, 2, ids), 2);
+  CHECK(ids[0] != 0 && ids[0] == ids[1]);
+  broker.receive();
+  uint16_t acked = 0;
+  std::vector<uint8_t> codes;
+  broker.client.onSubscribe([&](uint16_t packetId, const uint8_t *data, size_t count) {
+    acked = packetId;
+    codes.assign(data, data + count);
+  });
+  broker.send({0x90, 0x04, (uint8_t)(ids[0] >> 8), (uint8_t)ids[0], 0x00, 0x80});
+  CHECK_EQ(acked, ids[0]);
+  CHECK(codes == std::vector<uint8_t>({0x00, 0x80}));
+  CHECK_EQ(broker.disconnects, 0);
+
+  // packet ids wrap around without ever being 0
+  bool nonzero = true;
+  for (int i = 0; i < 0x10000; i++) {
+    nonzero = nonzero && broker.client.unsubscribe("x") != 0;
+    if (i % 1000 == 0) {
+      broker.receive();
+    }
+  }
+  CHECK(nonzero);
+  broker.receive();
+  CHECK(broker.client.subscribe("c", 0) != 0);
+}
+
+// With a keepalive of 1 s, a client that keeps publishing to a broker that
+// only answers PINGREQs stays connected, and so does a paused client that
+// reads nothing for longer than the timeout.
+static void testKeepalive() {
+  Broker broker;
+  broker.client.setKeepAlive(1);
+  CHECK(broker.connect());
+  int pings = 0;
+  uint64_t end = broker.loop.now() + 2500;
+  while (broker.loop.now() < end) {
+    broker.client.publish("t", 0, false, "x", 1);
+    std::vector<uint8_t> data = broker.receive();
+    for (size_t i = 0; i + 1 < data.size(); i += 2 + data[i + 1]) {
+      if (data[i] == 0xc0) {
+        pings++;
+        broker.send({0xd0, 0x00});
+      }
+    }
+  }
+  CHECK(pings > 0);
+  CHECK_EQ(broker.disconnects, 0);
+
+  broker.client.pauseReceive(true);
+  end = broker.loop.now() + 2500;
+  while (broker.loop.now() < end) {
+    broker.receive();
+  }
+  CHECK_EQ(broker.disconnects, 0);
+  broker.client.pauseReceive(false);
+  broker.send({0xd0, 0x00});
+  CHECK(broker.client.connected());
+
+  // a broker that stops answering is noticed
+  end = broker.loop.now() + 2500;
+  while (broker.loop.now() < end && broker.disconnects == 0) {
+    broker.receive();
+  }
+  CHECK_EQ(broker.disconnects, 1);
+}
+
+// a remaining length longer than 4 bytes, or a packet before the CONNACK,
+// drops the connection
+static void testMalformed() {
+  Broker broker;
+  CHECK(broker.connect());
+  broker.send({0x30, 0xff, 0xff, 0xff, 0xff, 0x01});
+  CHECK_EQ(broker.disconnects, 1);
+  CHECK(!broker.client.connected());
+
+  Broker early;
+  early.client.connect();
+  early.fd = accept(early.listener, NULL, NULL);
+  early.receive();
+  early.send(publishPacket("a", "1", 0, 0));
+  CHECK_EQ(early.disconnects, 1);
+  CHECK_EQ(early.messages.size(), 0);
+}
+
+int main() {
+  testSplitPublish();
+  testPacketsInOneSegment();
+  testPause();
+  testSubscribe();
+  testKeepalive();
+  testMalformed();
+  return MQTTNET_TEST_RESULT();
+}
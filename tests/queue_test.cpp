@@ -0,0 +1,154 @@
+#include <thread>
+
+#include "MqttNetQueue.hpp"
+#include "MqttNetSpscQueue.hpp"
+#include "MqttNetTest.hpp"
+
+static bool push(MqttNetMessageQueue<64, 8> &queue, const char *topic, size_t length, char fill) {
+  char *t;
+  uint8_t *payload;
+  if (!queue.push(strlen(topic), length, 1, false, &t, &payload)) {
+    return false;
+  }
+  memcpy(t, topic, strlen(topic));
+  memset(payload, fill, length);
+  return true;
+}
+
+static bool popMatches(MqttNetMessageQueue<64, 8> &queue, const char *topic, size_t length, char fill) {
+  MqttNetMessage message;
+  if (!queue.front(message)) {
+    return false;
+  }
+  bool match = strcmp(message.topic, topic) == 0 && message.length == length;
+  for (size_t i = 0; match && i < length; i++) {
+    match = message.payload[i] == fill;
+  }
+  queue.pop();
+  return match;
+}
+
+static void testMessageQueue() {
+  MqttNetMessageQueue<64, 8> queue;
+  CHECK(queue.empty());
+  CHECK_EQ(queue.recordSize(1, 10), 18);
+  // 3 records of 18 bytes leave 10 bytes at the end of the pool
+  CHECK(push(queue, "a", 10, 'a'));
+  CHECK(push(queue, "b", 10, 'b'));
+  CHECK(push(queue, "c", 10, 'c'));
+  CHECK(!queue.fits(1, 10));
+  CHECK(!push(queue, "d", 10, 'd'));
+  CHECK_EQ(queue.size(), 3);
+  CHECK(popMatches(queue, "a", 10, 'a'));
+
+  // the next record wraps to the start, the end of the pool is skipped
+  CHECK(queue.fits(1, 10));
+  CHECK(push(queue, "d", 10, 'd'));
+  CHECK_EQ(queue.bytes(), 64);
+  CHECK(!queue.fits(1, 0));
+  CHECK(popMatches(queue, "b", 10, 'b'));
+  CHECK(popMatches(queue, "c", 10, 'c'));
+  CHECK(popMatches(queue, "d", 10, 'd'));
+  CHECK(queue.empty());
+  CHECK_EQ(queue.bytes(), 0);
+
+  // wrapping many times with records of changing sizes
+  for (int i = 0; i < 100; i++) {
+    CHECK(push(queue, "x", i % 20, 'a' + i % 26));
+    CHECK(push(queue, "yy", (i * 7) % 13, 'A' + i % 26));
+    CHECK(popMatches(queue, "x", i % 20, 'a' + i % 26));
+    CHECK(popMatches(queue, "yy", (i * 7) % 13, 'A' + i % 26));
+  }
+  CHECK(queue.empty());
+
+  // Depth limits the count even when bytes are left
+  for (int i = 0; i < 8; i++) {
+    CHECK(push(queue, "", 0, 0));
+  }
+  CHECK(!push(queue, "", 0, 0));
+  queue.clear();
+  CHECK(queue.empty());
+}
+
+static void testSpscQueue() {
+  MqttNetSpscQueue<32> queue;
+  size_t size;
+  CHECK_EQ(queue.capacity(), 29);
+  CHECK(queue.front(&size) == nullptr);
+  CHECK(queue.reserve(30) == nullptr);
+
+  // 2 records of 10 bytes (12 with their headers)
+  for (int i = 0; i < 2; i++) {
+    uint8_t *record = queue.reserve(10);
+    CHECK(record != nullptr);
+    memset(record, i, 10);
+    queue.commit();
+  }
+  CHECK_EQ(queue.bytes(), 24);
+  CHECK(queue.reserve(10) == nullptr);
+  uint8_t *record = queue.front(&size);
+  CHECK_EQ(size, 10);
+  CHECK_EQ(record[9], 0);
+  queue.pop();
+
+  // the next record wraps, the 8 bytes at the end of the pool are skipped;
+  // it must stay short of the head to keep one byte free
+  CHECK(queue.reserve(10) == nullptr);
+  record = queue.reserve(9);
+  CHECK(record != nullptr);
+  memset(record, 2, 9);
+  queue.commit();
+  CHECK_EQ(queue.bytes(), 31);
+  record = queue.front(&size);
+  CHECK_EQ(record[0], 1);
+  queue.pop();
+  record = queue.front(&size);
+  CHECK_EQ(size, 9);
+  CHECK_EQ(record[0], 2);
+  queue.pop();
+  CHECK(queue.empty());
+  CHECK_EQ(queue.bytes(), 0);
+}
+
+// a producer and a consumer thread, checking that records arrive in order
+// and intact across many wraps
+static void testSpscThreads() {
+  static MqttNetSpscQueue<256> queue;
+  const int count = 100000;
+  std::thread producer([] {
+    for (int i = 0; i < count; i++) {
+      size_t length = 4 + i % 37;
+      uint8_t *record;
+      while ((record = queue.reserve(length)) == nullptr) {
+        std::this_thread::yield();
+      }
+      memcpy(record, &i, 4);
+      memset(record + 4, i & 0xff, length - 4);
+      queue.commit();
+    }
+  });
+  int errors = 0;
+  for (int i = 0; i < count; i++) {
+    size_t size;
+    uint8_t *record;
+    while ((record = queue.front(&size)) == nullptr) {
+      std::this_thread::yield();
+    }
+    int value;
+    memcpy(&value, record, 4);
+    if (value != i || size != (size_t)(4 + i % 37) || (size > 4 && record[size - 1] != (i & 0xff))) {
+      errors++;
+    }
+    queue.pop();
+  }
+  producer.join();
+  CHECK_EQ(errors, 0);
+  CHECK(queue.empty());
+}
+
+int main() {
+  testMessageQueue();
+  testSpscQueue();
+  testSpscThreads();
+  return MQTTNET_TEST_RESULT();
+}
@@ -0,0 +1,80 @@
+#include "MqttNetSubscriptions.hpp"
+#include "MqttNetTest.hpp"
+
+typedef MqttNetSubscriptionTable<64, 4> Table;
+
+static void testAdd() {
+  Table table;
+  CHECK(table.add("a/b", 0));
+  CHECK(table.add("c", 1));
+  CHECK_EQ(table.size(), 2);
+  CHECK_EQ(table.state(0), Table::PENDING);
+  table.setState(0, Table::ACTIVE);
+  // the same filter again only changes something when its qos differs
+  CHECK(table.add("a/b", 0));
+  CHECK_EQ(table.state(0), Table::ACTIVE);
+  CHECK(table.add("a/b", 1));
+  CHECK_EQ(table.state(0), Table::PENDING);
+
+  table.remove(0);
+  CHECK_EQ(table.size(), 1);
+  CHECK(strcmp(table.topic(0), "c") == 0);
+  CHECK_EQ(table.find("a/b"), -1);
+
+  CHECK(table.add("1", 0) && table.add("2", 0) && table.add("3", 0));
+  CHECK(!table.add("4", 0));
+}
+
+// filters sent in one SUBSCRIBE are matched to the codes of its SUBACK in
+// order, a rejected one is retried, the others stay active
+static void testAcknowledge() {
+  Table table;
+  table.add("a", 0);
+  table.add("b", 1);
+  table.add("c", 0);
+  table.setSent(0, 7);
+  table.setSent(1, 7);
+  table.setSent(2, 8);
+  CHECK(!table.any(Table::PENDING));
+
+  const uint8_t codes[] = {0x00, 0x80};
+  CHECK_EQ(table.acknowledge(7, codes, 2), 1);
+  CHECK_EQ(table.state(0), Table::ACTIVE);
+  CHECK_EQ(table.state(1), Table::FAILED);
+  CHECK_EQ(table.state(2), Table::SENT);
+  // a SUBACK for an unknown packet id changes nothing
+  CHECK_EQ(table.acknowledge(9, codes + 1, 1), 0);
+  CHECK_EQ(table.state(2), Table::SENT);
+
+  table.resend(Table::FAILED);
+  CHECK_EQ(table.state(1), Table::PENDING);
+  CHECK_EQ(table.state(0), Table::ACTIVE);
+
+  // the SUBACK for packet 8 was lost with the connection
+  table.resend(Table::SENT);
+  CHECK_EQ(table.state(2), Table::PENDING);
+  CHECK_EQ(table.acknowledge(8, codes, 1), 0);
+  CHECK_EQ(table.state(2), Table::PENDING);
+}
+
+static void testMarkAllPending() {
+  Table table;
+  table.add("a", 0);
+  table.add("b", 0);
+  table.add("c", 0);
+  table.setState(0, Table::ACTIVE);
+  table.setState(1, Table::UNSUBSCRIBE);
+  table.setSent(2, 3);
+  table.markAllPending();
+  CHECK_EQ(table.size(), 2);
+  CHECK(strcmp(table.topic(1), "c") == 0);
+  CHECK_EQ(table.state(0), Table::PENDING);
+  CHECK_EQ(table.state(1), Table::PENDING);
+}
+
+int main() {
+  testAdd();
+  testAcknowledge();
+  testMarkAllPending();
+  return MQTTNET_TEST_RESULT();
+}